@@ -0,0 +1,256 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include <learnopengl/dds.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Offline BC1/BC3/BC4/BC5 block compression and mip generation for the asset cooker. Favours simplicity over
+// the last bit of quality: color endpoints come from the principal axis of each block, alpha and single channel
+// blocks use their min/max range.
+namespace bc {
+
+inline uint16_t packRGB565(const float color[3])
+{
+    int r = (int)std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+    int g = (int)std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+    int b = (int)std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRGB565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// block: 16 RGBA texels. Writes 8 bytes, always in four color mode (also valid as the color half of BC3).
+inline void encodeColorBlock(const unsigned char block[16][4], unsigned char *out)
+{
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i][c] / 16.0f;
+
+    float covariance[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2]};
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+    // principal axis by power iteration
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+        float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float maxColor[3], minColor[3];
+    for (int c = 0; c < 3; c++)
+    {
+        maxColor[c] = mean[c] + axis[c] * maxProjection / std::max(axisLength, 1e-6f);
+        minColor[c] = mean[c] + axis[c] * minProjection / std::max(axisLength, 1e-6f);
+        // pull the endpoints slightly inwards, the extremes are rarely worth an exact palette entry
+        float inset = (maxColor[c] - minColor[c]) / 16.0f;
+        maxColor[c] -= inset;
+        minColor[c] += inset;
+    }
+
+    uint16_t color0 = packRGB565(maxColor);
+    uint16_t color1 = packRGB565(minColor);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+    out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// values: 16 single channel texels. Writes 8 bytes (BC4 block, also the alpha half of BC3).
+inline void encodeChannelBlock(const unsigned char values[16], unsigned char *out)
+{
+    int minValue = 255, maxValue = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        minValue = std::min(minValue, (int)values[i]);
+        maxValue = std::max(maxValue, (int)values[i]);
+    }
+    out[0] = (unsigned char)maxValue;
+    out[1] = (unsigned char)minValue;
+
+    uint64_t indices = 0;
+    if (maxValue != minValue)
+    {
+        // eight value mode: code 0 is max, 1 is min, codes 2..7 interpolate from max towards min
+        int palette[8];
+        palette[0] = maxValue;
+        palette[1] = minValue;
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * maxValue + i * minValue) / 7;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 256;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs(values[i] - palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+}
+
+// rgba: width x height RGBA8 texels. Returns the compressed blocks of one mip level.
+inline std::vector<unsigned char> CompressImage(const unsigned char *rgba, unsigned int width, unsigned int height, BlockFormat format)
+{
+    std::vector<unsigned char> out(CompressedLevelSize(format, width, height));
+    unsigned char *cursor = out.data();
+    for (unsigned int by = 0; by < height; by += 4)
+    {
+        for (unsigned int bx = 0; bx < width; bx += 4)
+        {
+            // gather the block, replicating the edge texels of images that aren't a multiple of 4
+            unsigned char block[16][4];
+            for (unsigned int y = 0; y < 4; y++)
+            {
+                for (unsigned int x = 0; x < 4; x++)
+                {
+                    unsigned int sx = std::min(bx + x, width - 1), sy = std::min(by + y, height - 1);
+                    for (int c = 0; c < 4; c++)
+                        block[y * 4 + x][c] = rgba[((size_t)sy * width + sx) * 4 + c];
+                }
+            }
+            unsigned char channel[16];
+            switch (format) {
+                case BlockFormat::BC1:
+                    bc::encodeColorBlock(block, cursor);
+                    break;
+                case BlockFormat::BC3:
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = block[i][3];
+                    bc::encodeChannelBlock(channel, cursor);
+                    bc::encodeColorBlock(block, cursor + 8);
+                    break;
+                case BlockFormat::BC4:
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = block[i][0];
+                    bc::encodeChannelBlock(channel, cursor);
+                    break;
+                case BlockFormat::BC5:
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = block[i][0];
+                    bc::encodeChannelBlock(channel, cursor);
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = block[i][1];
+                    bc::encodeChannelBlock(channel, cursor + 8);
+                    break;
+            }
+            cursor += BlockBytes(format);
+        }
+    }
+    return out;
+}
+
+// halves an RGBA8 image with a box filter. With srgb the color channels are averaged in linear space,
+// matching what glGenerateMipmap does for sRGB textures; alpha is always linear.
+inline std::vector<unsigned char> DownsampleImage(const unsigned char *rgba, unsigned int width, unsigned int height, bool srgb,
+                                                  unsigned int &outWidth, unsigned int &outHeight)
+{
+    static float toLinear[256];
+    static bool tableReady = false;
+    if (!tableReady)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        tableReady = true;
+    }
+
+    outWidth = std::max(1u, width / 2);
+    outHeight = std::max(1u, height / 2);
+    std::vector<unsigned char> out((size_t)outWidth * outHeight * 4);
+    for (unsigned int y = 0; y < outHeight; y++)
+    {
+        for (unsigned int x = 0; x < outWidth; x++)
+        {
+            unsigned int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            unsigned int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            const unsigned char *texels[4] = {
+                    rgba + ((size_t)y0 * width + x0) * 4, rgba + ((size_t)y0 * width + x1) * 4,
+                    rgba + ((size_t)y1 * width + x0) * 4, rgba + ((size_t)y1 * width + x1) * 4};
+            unsigned char *target = out.data() + ((size_t)y * outWidth + x) * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                float sum = 0.0f;
+                for (const unsigned char *texel : texels)
+                    sum += srgb && c < 3 ? toLinear[texel[c]] : texel[c] / 255.0f;
+                float value = sum / 4.0f;
+                if (srgb && c < 3)
+                    value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                target[c] = (unsigned char)std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+            }
+        }
+    }
+    return out;
+}
+#endif
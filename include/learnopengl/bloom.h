@@ -0,0 +1,271 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_ext.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// One side of a separable Gaussian blur, folded for linear sampling: every tap after the center one sits between
+// two texels, weighted so the bilinear filter returns their weighted sum, which covers a radius of R texels with
+// 1 + ceil(R / 2) fetches per side instead of 1 + R (Rakos, "Efficient Gaussian blur with linear sampling").
+// Offsets are in texels, the taps are applied at +offset and -offset.
+struct GaussianKernel
+{
+    static const unsigned int MAX_TAPS = 8;
+    // largest radius that fits into MAX_TAPS
+    static const unsigned int MAX_RADIUS = 2 * (MAX_TAPS - 1);
+
+    float weights[MAX_TAPS] = {};
+    float offsets[MAX_TAPS] = {};
+    unsigned int taps = 0;
+
+    static GaussianKernel Build(float sigma, unsigned int radius)
+    {
+        radius = std::min(std::max(radius, 1u), MAX_RADIUS);
+        sigma = std::max(sigma, 0.1f);
+        // discrete weights of texels 0..radius, normalized over the whole -radius..radius window
+        float discrete[MAX_RADIUS + 1];
+        float sum = 0.0f;
+        for (unsigned int i = 0; i <= radius; i++)
+        {
+            discrete[i] = std::exp(-0.5f * (float)(i * i) / (sigma * sigma));
+            sum += i == 0 ? discrete[i] : 2.0f * discrete[i];
+        }
+
+        GaussianKernel kernel;
+        kernel.weights[0] = discrete[0] / sum;
+        kernel.taps = 1;
+        for (unsigned int i = 1; i <= radius; i += 2)
+        {
+            float first = discrete[i] / sum;
+            float second = i + 1 <= radius ? discrete[i + 1] / sum : 0.0f;
+            kernel.weights[kernel.taps] = first + second;
+            kernel.offsets[kernel.taps] = (i * first + (i + 1) * second) / (first + second);
+            kernel.taps++;
+        }
+        return kernel;
+    }
+};
+
+// Progressive downsample/upsample bloom (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare").
+// The bright buffer is filtered down a chain of half-size targets with a 13-tap box filter, then blurred back up
+// with a 3x3 tent filter, each level added onto the next larger one. Every pass after the first touches a quarter
+// of the pixels of the previous one, so the whole chain costs less than a single full resolution blur pass while
+// the blur radius roughly doubles with every level.
+class BloomMipChain
+{
+public:
+    static const unsigned int MAX_MIPS = 8;
+
+    // levels used by Render, at most MAX_MIPS
+    unsigned int Mips = 6;
+    // upsample filter radius in texels of the smaller level
+    float FilterRadius = 1.0f;
+
+    // width and height of the bright buffer, the first level is half that
+    BloomMipChain(unsigned int width, unsigned int height)
+        : downsampleShader("resources/shaders/blur.vs", "resources/shaders/bloom_downsample.fs"),
+          upsampleShader("resources/shaders/blur.vs", "resources/shaders/bloom_upsample.fs")
+    {
+        downsampleShader.use();
+        downsampleShader.setInt("srcTexture", 0);
+        upsampleShader.use();
+        upsampleShader.setInt("srcTexture", 0);
+        upsampleRadius = upsampleShader.uniform("filterRadius");
+
+        glGenFramebuffers(MAX_MIPS, framebuffers);
+        glGenTextures(MAX_MIPS, textures);
+        Resize(width, height);
+    }
+
+    BloomMipChain(const BloomMipChain&) = delete;
+    BloomMipChain& operator=(const BloomMipChain&) = delete;
+
+    ~BloomMipChain()
+    {
+        glDeleteFramebuffers(MAX_MIPS, framebuffers);
+        glDeleteTextures(MAX_MIPS, textures);
+    }
+
+    // reallocates the levels for a bright buffer of width x height in the given color format,
+    // does nothing when neither changed
+    void Resize(unsigned int width, unsigned int height, GLenum format = GL_RGBA16F)
+    {
+        if (width == this->width && height == this->height && format == this->format)
+            return;
+        bool attach = this->width == 0;
+        this->width = width;
+        this->height = height;
+        this->format = format;
+        for (unsigned int i = 0; i < MAX_MIPS; i++)
+        {
+            widths[i] = std::max(width >> (i + 1), 1u);
+            heights[i] = std::max(height >> (i + 1), 1u);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, widths[i], heights[i], 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            if (!attach)
+                continue;
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::BLOOM:: mip framebuffer " << i << " not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // video memory of all levels, bytesPerPixel of the current format
+    size_t MemoryBytes(unsigned int bytesPerPixel) const
+    {
+        size_t pixels = 0;
+        for (unsigned int i = 0; i < MAX_MIPS; i++)
+            pixels += (size_t)widths[i] * heights[i];
+        return pixels * bytesPerPixel;
+    }
+
+    // blurs brightTexture and returns the texture holding the result (half resolution, linear filtered).
+    // drawQuad draws a full screen quad with positions at location 0 and texture coordinates at location 1.
+    // Leaves the bloom framebuffer bound, restores viewport, blending and depth test.
+    unsigned int Render(unsigned int brightTexture, void (*drawQuad)())
+    {
+        GLState &state = GLState::Instance();
+        unsigned int mips = std::min(std::max(Mips, 1u), MAX_MIPS);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        bool blend = state.IsEnabled(GL_BLEND);
+        GLenum blendSource, blendDestination;
+        state.GetBlendFunc(blendSource, blendDestination);
+        bool depthTest = state.IsEnabled(GL_DEPTH_TEST);
+        state.SetEnabled(GL_DEPTH_TEST, false);
+
+        // downsample: every level filters the one above it, the first one the bright buffer
+        state.SetEnabled(GL_BLEND, false);
+        downsampleShader.use();
+        for (unsigned int i = 0; i < mips; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glViewport(0, 0, widths[i], heights[i]);
+            state.BindTexture(0, GL_TEXTURE_2D, i == 0 ? brightTexture : textures[i - 1]);
+            drawQuad();
+        }
+
+        // upsample: blur every level into the next larger one, adding to what the downsample left there
+        state.SetEnabled(GL_BLEND, true);
+        state.BlendFunc(GL_ONE, GL_ONE);
+        upsampleShader.use();
+        upsampleShader.setFloat(upsampleRadius, FilterRadius);
+        for (unsigned int i = mips - 1; i > 0; i--)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i - 1]);
+            glViewport(0, 0, widths[i - 1], heights[i - 1]);
+            state.BindTexture(0, GL_TEXTURE_2D, textures[i]);
+            drawQuad();
+        }
+
+        state.BlendFunc(blendSource, blendDestination);
+        state.SetEnabled(GL_BLEND, blend);
+        state.SetEnabled(GL_DEPTH_TEST, depthTest);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return textures[0];
+    }
+
+private:
+    Shader downsampleShader;
+    Shader upsampleShader;
+    UniformHandle upsampleRadius;
+    unsigned int framebuffers[MAX_MIPS];
+    unsigned int textures[MAX_MIPS];
+    unsigned int widths[MAX_MIPS];
+    unsigned int heights[MAX_MIPS];
+    unsigned int width = 0, height = 0;
+    GLenum format = GL_RGBA16F;
+};
+
+// Separable Gaussian bloom in compute shaders (OpenGL 4.3, GLExt::ComputeSupported): the bright-pass extraction
+// is folded into the horizontal pass and each pass blurs the full radius at once out of shared memory, so the whole
+// bloom is two dispatches with no framebuffer switches instead of ten full screen fragment passes.
+class ComputeBloom
+{
+public:
+    // has to match bloom_blur.cs
+    static const unsigned int TILE = 128;
+    static const unsigned int MAX_RADIUS = 16;
+
+    ComputeBloom()
+        : blurShader("resources/shaders/bloom_blur.cs")
+    {
+        horizontal = blurShader.uniform("horizontal");
+        extractBright = blurShader.uniform("extractBright");
+        threshold = blurShader.uniform("threshold");
+        radius = blurShader.uniform("radius");
+        weights = blurShader.uniform("weight");
+        SetKernel(4.0f, 12);
+    }
+
+    ComputeBloom(const ComputeBloom&) = delete;
+    ComputeBloom& operator=(const ComputeBloom&) = delete;
+
+    // discrete Gaussian weights for texels 0..radius, uploaded once
+    void SetKernel(float sigma, unsigned int kernelRadius)
+    {
+        kernelRadius = std::min(std::max(kernelRadius, 1u), MAX_RADIUS);
+        sigma = std::max(sigma, 0.1f);
+        float kernel[MAX_RADIUS + 1];
+        float sum = 0.0f;
+        for (unsigned int i = 0; i <= kernelRadius; i++)
+        {
+            kernel[i] = std::exp(-0.5f * (float)(i * i) / (sigma * sigma));
+            sum += i == 0 ? kernel[i] : 2.0f * kernel[i];
+        }
+        for (unsigned int i = 0; i <= kernelRadius; i++)
+            kernel[i] /= sum;
+        blurShader.use();
+        blurShader.setInt(radius, (int)kernelRadius);
+        blurShader.setFloatArray(weights, kernel, (int)kernelRadius + 1);
+    }
+
+    // blurs the parts of sceneTexture brighter than brightThreshold through the two width x height textures
+    // of the given format in targets and returns the one holding the result. The scene may be larger than the
+    // targets, the first pass filters it down.
+    unsigned int Render(unsigned int sceneTexture, float brightThreshold, const unsigned int targets[2], unsigned int width, unsigned int height, GLenum format)
+    {
+        GLExt &ext = GLExt::Instance();
+        GLState &state = GLState::Instance();
+        blurShader.use();
+
+        state.BindTexture(0, GL_TEXTURE_2D, sceneTexture);
+        ext.BindImageTexture(0, targets[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, format);
+        blurShader.setBool(horizontal, true);
+        blurShader.setBool(extractBright, true);
+        blurShader.setFloat(threshold, brightThreshold);
+        ext.DispatchCompute((width + TILE - 1) / TILE, height, 1);
+        ext.Barrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        state.BindTexture(0, GL_TEXTURE_2D, targets[0]);
+        ext.BindImageTexture(0, targets[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, format);
+        blurShader.setBool(horizontal, false);
+        blurShader.setBool(extractBright, false);
+        ext.DispatchCompute((height + TILE - 1) / TILE, width, 1);
+        // the composite samples the result
+        ext.Barrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        return targets[1];
+    }
+
+private:
+    Shader blurShader;
+    UniformHandle horizontal;
+    UniformHandle extractBright;
+    UniformHandle threshold;
+    UniformHandle radius;
+    UniformHandle weights;
+};
+#endif
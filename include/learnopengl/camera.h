@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cmath>
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -108,6 +109,15 @@ public:
         updateCameraVectors();
     }
 
+    // turns the camera towards a point, used by scripted camera paths
+    void LookAt(glm::vec3 target)
+    {
+        glm::vec3 direction = glm::normalize(target - Position);
+        Yaw = glm::degrees(std::atan2(direction.z, direction.x));
+        Pitch = glm::degrees(std::asin(direction.y));
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
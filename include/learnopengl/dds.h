@@ -0,0 +1,212 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <glad/glad.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// S3TC is an extension on desktop GL and not part of the generated 3.3 core loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Block compressed textures cooked by the asset cooker, stored as legacy (FourCC) DDS files next to the source image
+// (<image>.png.dds) with the full mip chain. Unlike regular DDS files the rows are stored bottom-up, already flipped
+// for OpenGL, the same way stbi_set_flip_vertically_on_load(true) delivers them at runtime.
+enum class BlockFormat {
+    BC1,    // DXT1, opaque color
+    BC3,    // DXT5, color with alpha
+    BC4,    // ATI1, single channel
+    BC5     // ATI2, two channels (tangent space normal maps)
+};
+
+struct DdsImage {
+    BlockFormat format = BlockFormat::BC1;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    // one entry per mip level, pointing into the parsed file
+    std::vector<const unsigned char*> levels;
+    std::vector<size_t> levelSizes;
+};
+
+namespace dds {
+
+const uint32_t MAGIC = 0x20534444; // "DDS "
+const uint32_t HEADER_SIZE = 124;
+const uint32_t PIXEL_FORMAT_SIZE = 32;
+const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+
+inline uint32_t fourCC(const char *code)
+{
+    return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+}
+
+inline const char *formatFourCC(BlockFormat format)
+{
+    switch (format) {
+        case BlockFormat::BC1: return "DXT1";
+        case BlockFormat::BC3: return "DXT5";
+        case BlockFormat::BC4: return "ATI1";
+        case BlockFormat::BC5: return "ATI2";
+    }
+    return "DXT1";
+}
+
+}
+
+// bytes per 4x4 block
+inline size_t BlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+inline size_t CompressedLevelSize(BlockFormat format, unsigned int width, unsigned int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+inline GLenum CompressedInternalFormat(BlockFormat format, bool gamma)
+{
+    switch (format) {
+        case BlockFormat::BC1: return gamma ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3: return gamma ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        // RGTC has no sRGB variant, like the GL_RED/GL_RG uploads of uncompressed images
+        case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+inline bool ParseDds(const unsigned char *data, size_t size, DdsImage &image)
+{
+    uint32_t header[1 + dds::HEADER_SIZE / 4];
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(header, data, sizeof(header));
+    // header[1 + i] is the i-th DWORD of DDS_HEADER, the pixel format starts at DWORD 18
+    if (header[0] != dds::MAGIC || header[1] != dds::HEADER_SIZE || header[19] != dds::PIXEL_FORMAT_SIZE || !(header[20] & dds::DDPF_FOURCC))
+        return false;
+    uint32_t code = header[21];
+    if (code == dds::fourCC("DXT1"))
+        image.format = BlockFormat::BC1;
+    else if (code == dds::fourCC("DXT5"))
+        image.format = BlockFormat::BC3;
+    else if (code == dds::fourCC("ATI1") || code == dds::fourCC("BC4U"))
+        image.format = BlockFormat::BC4;
+    else if (code == dds::fourCC("ATI2") || code == dds::fourCC("BC5U"))
+        image.format = BlockFormat::BC5;
+    else
+        return false;
+
+    image.height = header[3];
+    image.width = header[4];
+    unsigned int mipCount = (header[2] & dds::DDSD_MIPMAPCOUNT) && header[7] > 0 ? header[7] : 1;
+    image.levels.clear();
+    image.levelSizes.clear();
+
+    size_t offset = sizeof(header);
+    unsigned int width = image.width, height = image.height;
+    for (unsigned int level = 0; level < mipCount; level++)
+    {
+        size_t levelSize = CompressedLevelSize(image.format, width, height);
+        if (offset + levelSize > size)
+            break;
+        image.levels.push_back(data + offset);
+        image.levelSizes.push_back(levelSize);
+        offset += levelSize;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return !image.levels.empty();
+}
+
+// levels[i] holds the compressed blocks of mip level i, level 0 being width x height
+inline bool WriteDds(const std::string &path, BlockFormat format, unsigned int width, unsigned int height,
+                     const std::vector<std::vector<unsigned char>> &levels)
+{
+    uint32_t header[1 + dds::HEADER_SIZE / 4] = {};
+    header[0] = dds::MAGIC;
+    header[1] = dds::HEADER_SIZE;
+    header[2] = dds::DDSD_CAPS | dds::DDSD_HEIGHT | dds::DDSD_WIDTH | dds::DDSD_PIXELFORMAT | dds::DDSD_MIPMAPCOUNT | dds::DDSD_LINEARSIZE;
+    header[3] = height;
+    header[4] = width;
+    header[5] = (uint32_t)CompressedLevelSize(format, width, height);
+    header[7] = (uint32_t)levels.size();
+    header[19] = dds::PIXEL_FORMAT_SIZE;
+    header[20] = dds::DDPF_FOURCC;
+    header[21] = dds::fourCC(dds::formatFourCC(format));
+    header[27] = dds::DDSCAPS_TEXTURE | (levels.size() > 1 ? dds::DDSCAPS_COMPLEX | dds::DDSCAPS_MIPMAP : 0);
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const std::vector<unsigned char> &level : levels)
+        out.write(reinterpret_cast<const char*>(level.data()), level.size());
+    out.close();
+    if (!out || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+inline std::string CookedTexturePath(const std::string &sourcePath)
+{
+    return sourcePath + ".dds";
+}
+
+// true if the cooked file exists and is at least as new as its source image
+inline bool CookedTextureUpToDate(const std::string &sourcePath)
+{
+    struct stat source, cooked;
+    if (stat(CookedTexturePath(sourcePath).c_str(), &cooked) != 0)
+        return false;
+    if (stat(sourcePath.c_str(), &source) != 0)
+        return true;
+    return cooked.st_mtime >= source.st_mtime;
+}
+
+// whether the current context can sample the cooked formats. Needs a current context, the result is cached.
+inline bool CompressedTexturesSupported()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        bool s3tc = false, srgb = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                s3tc = true;
+            else if (std::strcmp(name, "GL_EXT_texture_sRGB") == 0 || std::strcmp(name, "GL_EXT_texture_compression_s3tc_srgb") == 0)
+                srgb = true;
+        }
+        supported = s3tc && srgb ? 1 : 0;
+    }
+    return supported == 1;
+}
+#endif
@@ -0,0 +1,175 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/render_targets.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform_buffer.h>
+
+#include <cmath>
+#include <vector>
+
+// Lighting of the deferred renderer. The opaque models are drawn once into the G-buffer of RenderTargets
+// (gbuffer.fs: albedo, specular color, normal and view depth, sharing the scene's depth buffer), then Render
+// lights what ended up visible:
+//   - one full screen pass for the directional light and the flashlight,
+//   - a sphere around every point light, instanced out of the light buffer of LightClusters, its back faces drawn
+//     with GL_GEQUAL so only the pixels with a surface inside the sphere run the light's shader, added on top,
+//   - and the bright color for the bloom, extracted from the sum.
+// Every pixel is shaded once per light that reaches it, however many surfaces were drawn over each other there.
+// The alpha tested plants and the blended water are drawn forward afterwards, into the same color and depth.
+class DeferredLighting
+{
+public:
+    // shininess is the one all materials of the scene use
+    explicit DeferredLighting(float shininess)
+        : directionalShader("resources/shaders/blur.vs", "resources/shaders/deferred_directional.fs"),
+          pointShader("resources/shaders/deferred_point.vs", "resources/shaders/deferred_point.fs"),
+          brightShader("resources/shaders/blur.vs", "resources/shaders/deferred_bright.fs")
+    {
+        for (Shader *shader : {&directionalShader, &pointShader})
+        {
+            shader->BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+            shader->BindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+            shader->use();
+            shader->setInt("gAlbedo", 0);
+            shader->setInt("gSpecular", 1);
+            shader->setInt("gNormalDepth", 2);
+            shader->setFloat("shininess", shininess);
+        }
+        LightClusters::SetSamplers(pointShader);
+        brightShader.use();
+        brightShader.setInt("scene", 0);
+        brightThreshold = brightShader.uniform("bloomThreshold");
+        createSphere();
+    }
+
+    DeferredLighting(const DeferredLighting&) = delete;
+    DeferredLighting& operator=(const DeferredLighting&) = delete;
+
+    ~DeferredLighting()
+    {
+        glDeleteVertexArrays(1, &sphereVAO);
+        glDeleteBuffers(1, &sphereVBO);
+        glDeleteBuffers(1, &sphereEBO);
+    }
+
+    // lights the filled G-buffer into the scene color and bright buffers. The first lightCount lights of the light
+    // buffer have to be bound (LightClusters::Bind), drawQuad draws a full screen quad with positions at location 0
+    // and texture coordinates at location 1. Leaves the HDR framebuffer bound and restores blending and depth test.
+    void Render(const RenderTargets &targets, unsigned int lightCount, float bloomThreshold, void (*drawQuad)())
+    {
+        GLState &state = GLState::Instance();
+        bool blend = state.IsEnabled(GL_BLEND);
+        GLenum blendSource, blendDestination;
+        state.GetBlendFunc(blendSource, blendDestination);
+        bool depthTest = state.IsEnabled(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, targets.HdrFramebuffer);
+        for (unsigned int i = 0; i < 3; i++)
+            state.BindTexture(i, GL_TEXTURE_2D, targets.GBuffers[i]);
+        state.DepthMask(false);
+
+        // lights reaching every pixel, writes the scene color the point lights are added to
+        state.SetEnabled(GL_DEPTH_TEST, false);
+        state.SetEnabled(GL_BLEND, false);
+        directionalShader.use();
+        drawQuad();
+
+        // light volumes: the back faces of the sphere behind or on the surface, wherever the camera is. Depth clamping
+        // keeps the parts of a large sphere behind the far plane, which would otherwise be clipped away.
+        if (lightCount > 0)
+        {
+            state.SetEnabled(GL_DEPTH_TEST, true);
+            state.DepthFunc(GL_GEQUAL);
+            state.SetEnabled(GL_CULL_FACE, true);
+            state.CullFace(GL_FRONT);
+            state.SetEnabled(GL_DEPTH_CLAMP, true);
+            state.SetEnabled(GL_BLEND, true);
+            state.BlendFunc(GL_ONE, GL_ONE);
+            pointShader.use();
+            state.BindVertexArray(sphereVAO);
+            glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, nullptr, lightCount);
+            state.SetEnabled(GL_DEPTH_CLAMP, false);
+            state.SetEnabled(GL_CULL_FACE, false);
+            state.CullFace(GL_BACK);
+            state.DepthFunc(GL_LESS);
+            state.BlendFunc(blendSource, blendDestination);
+        }
+
+        // the bright color of the sum, into the bright buffer alone so the scene color can be read
+        glBindFramebuffer(GL_FRAMEBUFFER, targets.BrightFramebuffer);
+        state.SetEnabled(GL_DEPTH_TEST, false);
+        state.SetEnabled(GL_BLEND, false);
+        brightShader.use();
+        brightShader.setFloat(brightThreshold, bloomThreshold);
+        state.BindTexture(0, GL_TEXTURE_2D, targets.ColorBuffers[0]);
+        drawQuad();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, targets.HdrFramebuffer);
+        state.DepthMask(true);
+        state.SetEnabled(GL_BLEND, blend);
+        state.SetEnabled(GL_DEPTH_TEST, depthTest);
+    }
+
+private:
+    // the light volume, a UV sphere with its vertices on the unit sphere
+    static const unsigned int STACKS = 12;
+    static const unsigned int SLICES = 16;
+
+    Shader directionalShader;
+    Shader pointShader;
+    Shader brightShader;
+    UniformHandle brightThreshold;
+    unsigned int sphereVAO = 0, sphereVBO = 0, sphereEBO = 0;
+    GLsizei sphereIndexCount = 0;
+
+    void createSphere()
+    {
+        const float pi = 3.14159265f;
+        std::vector<float> positions;
+        for (unsigned int stack = 0; stack <= STACKS; stack++)
+        {
+            float latitude = pi * stack / STACKS;
+            for (unsigned int slice = 0; slice <= SLICES; slice++)
+            {
+                float longitude = 2.0f * pi * slice / SLICES;
+                positions.push_back(std::sin(latitude) * std::cos(longitude));
+                positions.push_back(std::cos(latitude));
+                positions.push_back(std::sin(latitude) * std::sin(longitude));
+            }
+        }
+        // counter-clockwise seen from outside
+        std::vector<unsigned int> indices;
+        for (unsigned int stack = 0; stack < STACKS; stack++)
+        {
+            for (unsigned int slice = 0; slice < SLICES; slice++)
+            {
+                unsigned int first = stack * (SLICES + 1) + slice;
+                unsigned int second = first + SLICES + 1;
+                indices.insert(indices.end(), {first, first + 1, second, second, first + 1, second + 1});
+            }
+        }
+        sphereIndexCount = (GLsizei)indices.size();
+
+        glGenVertexArrays(1, &sphereVAO);
+        glGenBuffers(1, &sphereVBO);
+        glGenBuffers(1, &sphereEBO);
+        GLState::Instance().BindVertexArray(sphereVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        GLState::Instance().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the faces span at most 2 pi / SLICES, none comes closer to the center than cos(pi / SLICES)
+        pointShader.use();
+        pointShader.setFloat("inflate", 1.0f / std::cos(pi / SLICES));
+    }
+};
+#endif
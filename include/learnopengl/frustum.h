@@ -0,0 +1,151 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// axis aligned bounding box, min > max while empty
+struct AABB {
+    glm::vec3 min = glm::vec3(1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    void Extend(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Extend(const AABB &box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    bool Empty() const
+    {
+        return min.x > max.x;
+    }
+
+    glm::vec3 Center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    // box around this box transformed by the matrix (Arvo, "Transforming Axis-Aligned Bounding Boxes")
+    AABB Transformed(const glm::mat4 &matrix) const
+    {
+        AABB box;
+        box.min = box.max = glm::vec3(matrix[3]);
+        for (int column = 0; column < 3; column++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                float a = matrix[column][row] * min[column];
+                float b = matrix[column][row] * max[column];
+                box.min[row] += std::min(a, b);
+                box.max[row] += std::max(a, b);
+            }
+        }
+        return box;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // sphere around this sphere transformed by the matrix, the radius grows with the largest axis scale
+    BoundingSphere Transformed(const glm::mat4 &matrix) const
+    {
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+        sphere.radius = radius * scale;
+        return sphere;
+    }
+};
+
+// number of draws a culling pass let through and skipped, reset every frame
+struct CullStats {
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+
+    void Reset()
+    {
+        visible = culled = 0;
+    }
+
+    void Count(bool isVisible)
+    {
+        if (isVisible)
+            visible++;
+        else
+            culled++;
+    }
+};
+
+// The six planes of a view frustum, extracted from projection * view (Gribb and Hartmann), normals pointing inside.
+// The tests are conservative: a volume near a frustum corner can pass while lying outside.
+class Frustum
+{
+public:
+    // contains everything, for drawing without culling
+    Frustum()
+    {
+        for (glm::vec4 &plane : planes)
+            plane = glm::vec4(0.0f);
+    }
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            planes[2 * i] = row(viewProjection, 3) + row(viewProjection, i);
+            planes[2 * i + 1] = row(viewProjection, 3) - row(viewProjection, i);
+        }
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool Intersects(const BoundingSphere &sphere) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+                return false;
+        }
+        return true;
+    }
+
+    bool Intersects(const AABB &box) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            // the box corner furthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x,
+                             plane.y >= 0.0f ? box.max.y : box.min.y,
+                             plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    // sphere test first, it is cheaper and rejects most of what is outside; the box then trims the rest
+    bool Intersects(const AABB &box, const BoundingSphere &sphere, const glm::mat4 &model) const
+    {
+        return Intersects(sphere.Transformed(model)) && Intersects(box.Transformed(model));
+    }
+
+private:
+    // left, right, bottom, top, near, far
+    glm::vec4 planes[6];
+
+    static glm::vec4 row(const glm::mat4 &matrix, int index)
+    {
+        return glm::vec4(matrix[0][index], matrix[1][index], matrix[2][index], matrix[3][index]);
+    }
+};
+#endif
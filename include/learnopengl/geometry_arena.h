@@ -0,0 +1,313 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_ext.h>
+#include <learnopengl/gl_state.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// the vertex format of every mesh, they all share the arena's vertex buffer
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// where a mesh lives in the arena: its indices start at firstIndex and are relative to baseVertex
+struct GeometryRange {
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    int baseVertex = 0;
+};
+
+// the layout glMultiDrawElementsIndirect reads from the indirect buffer
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// One vertex buffer and one index buffer that the meshes of all models are suballocated from, behind a single
+// vertex array, so drawing the scene never switches vertex arrays. The per-instance model matrices (locations 5 to 8,
+// one column each) come from a stream the models append to every frame, a draw addresses its matrices with a
+// base instance.
+//
+// The positions are kept a second time in a tightly packed buffer with its own vertex array (location 0 and the
+// instance matrices only), for the depth pre-pass: a quarter of the vertex bytes to fetch.
+//
+// Draws are issued with one glMultiDrawElementsIndirect per call on OpenGL 4.3, otherwise with one
+// glDrawElementsInstancedBaseVertex per command, which has no base instance: the instance attributes are
+// pointed at the command's matrices before each draw instead.
+//
+// Loaded models are kept until the program exits, so the arena only grows; space is never handed back.
+class GeometryArena
+{
+public:
+    // uses multi-draw indirect where it is supported, can be switched off to compare
+    bool MultiDraw = true;
+
+    static GeometryArena& Instance()
+    {
+        static GeometryArena arena;
+        return arena;
+    }
+
+    // copies the mesh into the buffers, growing them when they are full
+    GeometryRange Allocate(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
+    {
+        if (!vertexArrays[FULL])
+            create();
+        if (vertexCount + usedVertices > vertexCapacity)
+        {
+            vertexCapacity = std::max(vertexCapacity * 2, vertexCount + usedVertices);
+            grow(vertexBuffer, usedVertices * sizeof(Vertex), vertexCapacity * sizeof(Vertex));
+            grow(positionBuffer, usedVertices * sizeof(glm::vec3), vertexCapacity * sizeof(glm::vec3));
+            attach();
+        }
+        // the copy targets leave the bound vertex array's element buffer alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, usedVertices * sizeof(Vertex), vertexCount * sizeof(Vertex), vertexData);
+        positions.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+            positions[i] = vertexData[i].Position;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, usedVertices * sizeof(glm::vec3), vertexCount * sizeof(glm::vec3), positions.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        GeometryRange range = AllocateIndices(indexData, indexCount, (int)usedVertices);
+        usedVertices += vertexCount;
+        return range;
+    }
+
+    // copies more indices over vertices already in the arena (the levels of detail of a mesh), they are relative
+    // to baseVertex like those of the range the vertices were allocated with
+    GeometryRange AllocateIndices(const unsigned int *indexData, size_t indexCount, int baseVertex)
+    {
+        if (!vertexArrays[FULL])
+            create();
+        if (indexCount + usedIndices > indexCapacity)
+        {
+            indexCapacity = std::max(indexCapacity * 2, indexCount + usedIndices);
+            grow(indexBuffer, usedIndices * sizeof(unsigned int), indexCapacity * sizeof(unsigned int));
+            attach();
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, usedIndices * sizeof(unsigned int), indexCount * sizeof(unsigned int), indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        GeometryRange range;
+        range.firstIndex = (unsigned int)usedIndices;
+        range.indexCount = (unsigned int)indexCount;
+        range.baseVertex = baseVertex;
+        usedIndices += indexCount;
+        return range;
+    }
+
+    // drops the instances and commands of the last frame, call once per frame before anything is drawn
+    void BeginFrame()
+    {
+        instances.clear();
+        commands.clear();
+        instanceStream.uploaded = 0;
+        commandStream.uploaded = 0;
+    }
+
+    // appends model matrices for this frame and returns the base instance of the first one
+    unsigned int AddInstances(const glm::mat4 *transforms, size_t count)
+    {
+        unsigned int baseInstance = (unsigned int)instances.size();
+        instances.insert(instances.end(), transforms, transforms + count);
+        return baseInstance;
+    }
+
+    // issues the commands, returns the number of draw calls that took. positionsOnly draws from the packed
+    // positions, for shaders that read nothing but location 0 and the instance matrices.
+    unsigned int Draw(const DrawElementsIndirectCommand *drawCommands, size_t count, bool positionsOnly = false)
+    {
+        if (count == 0)
+            return 0;
+        unsigned int layout = positionsOnly ? POSITIONS : FULL;
+        GLState::Instance().BindVertexArray(vertexArrays[layout]);
+        upload(instanceStream, instances.data(), instances.size() * sizeof(glm::mat4));
+        if (MultiDrawIndirect())
+        {
+            // the base instance of every command does the offsetting
+            pointInstances(layout, 0);
+            size_t offset = commands.size() * sizeof(DrawElementsIndirectCommand);
+            commands.insert(commands.end(), drawCommands, drawCommands + count);
+            upload(commandStream, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+            GLExt::Instance().MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)offset, (GLsizei)count, 0);
+            return 1;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            const DrawElementsIndirectCommand &command = drawCommands[i];
+            pointInstances(layout, command.baseInstance);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                              (const void*)(command.firstIndex * sizeof(unsigned int)),
+                                              command.instanceCount, command.baseVertex);
+        }
+        return (unsigned int)count;
+    }
+
+    bool MultiDrawIndirect() const
+    {
+        return MultiDraw && GLExt::Instance().MultiDrawIndirectSupported();
+    }
+
+    // bytes of geometry in use and allocated, the packed positions included
+    size_t UsedBytes() const
+    {
+        return usedVertices * (sizeof(Vertex) + sizeof(glm::vec3)) + usedIndices * sizeof(unsigned int);
+    }
+
+    size_t CapacityBytes() const
+    {
+        return vertexCapacity * (sizeof(Vertex) + sizeof(glm::vec3)) + indexCapacity * sizeof(unsigned int);
+    }
+
+private:
+    // a buffer refilled every frame: the first upload of a frame orphans last frame's storage, later ones append
+    struct Stream {
+        GLenum target;
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        size_t uploaded = 0;
+    };
+
+    // the vertex arrays, over all attributes or over the packed positions
+    enum Layout { FULL, POSITIONS };
+
+    unsigned int vertexArrays[2] = {0, 0};
+    unsigned int vertexBuffer = 0, indexBuffer = 0, positionBuffer = 0;
+    size_t usedVertices = 0, vertexCapacity = 0;
+    size_t usedIndices = 0, indexCapacity = 0;
+
+    Stream instanceStream, commandStream;
+    std::vector<glm::mat4> instances;
+    std::vector<DrawElementsIndirectCommand> commands;
+    // positions of the mesh being allocated
+    std::vector<glm::vec3> positions;
+    // per vertex array the base instance the instance attributes currently start at, only moved on the fallback path
+    unsigned int instanceOffsets[2] = {0, 0};
+
+    GeometryArena()
+    {
+        instanceStream.target = GL_ARRAY_BUFFER;
+        commandStream.target = GL_DRAW_INDIRECT_BUFFER;
+    }
+
+    void create()
+    {
+        glGenVertexArrays(2, vertexArrays);
+        glGenBuffers(1, &instanceStream.buffer);
+        glGenBuffers(1, &commandStream.buffer);
+        // a draw without instances still finds a matrix behind the instance attributes
+        instanceStream.capacity = 64 * sizeof(glm::mat4);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceStream.buffer);
+        glBufferData(GL_ARRAY_BUFFER, instanceStream.capacity, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // replaces buffer by a larger one holding the same first usedBytes
+    static void grow(unsigned int &buffer, size_t usedBytes, size_t capacityBytes)
+    {
+        unsigned int larger;
+        glGenBuffers(1, &larger);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, larger);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacityBytes, nullptr, GL_STATIC_DRAW);
+        if (buffer)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        buffer = larger;
+    }
+
+    // points the vertex arrays at the current buffers
+    void attach()
+    {
+        GLState::Instance().BindVertexArray(vertexArrays[FULL]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        instanceOffsets[FULL] = ~0u;
+        pointInstances(FULL, 0);
+
+        GLState::Instance().BindVertexArray(vertexArrays[POSITIONS]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        instanceOffsets[POSITIONS] = ~0u;
+        pointInstances(POSITIONS, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // expects the layout's vertex array bound
+    void pointInstances(unsigned int layout, unsigned int baseInstance)
+    {
+        if (baseInstance == instanceOffsets[layout])
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceStream.buffer);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void*)(baseInstance * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        instanceOffsets[layout] = baseInstance;
+    }
+
+    // uploads what was appended to data since the last upload, bytes is the size of all of it
+    static void upload(Stream &stream, const void *data, size_t bytes)
+    {
+        glBindBuffer(stream.target, stream.buffer);
+        if (bytes <= stream.uploaded)
+            return;
+        if (stream.uploaded == 0 || bytes > stream.capacity)
+        {
+            // fresh storage, the draws already issued keep reading the old one
+            if (bytes > stream.capacity)
+                stream.capacity = std::max(bytes, stream.capacity * 2);
+            glBufferData(stream.target, stream.capacity, nullptr, GL_STREAM_DRAW);
+            stream.uploaded = 0;
+        }
+        glBufferSubData(stream.target, stream.uploaded, bytes - stream.uploaded, (const char*)data + stream.uploaded);
+        stream.uploaded = bytes;
+    }
+};
+#endif
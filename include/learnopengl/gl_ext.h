@@ -0,0 +1,72 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+
+// OpenGL 4.2 / 4.3 constants, the glad loader in libs/glad only covers OpenGL 3.3 core
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// The few entry points newer than 3.3 that the optional code paths use. They stay null unless the context is
+// recent enough, so callers check ComputeSupported() or MultiDrawIndirectSupported() before touching any of them.
+class GLExt
+{
+public:
+    typedef void (APIENTRYP DispatchComputeProc)(GLuint numGroupsX, GLuint numGroupsY, GLuint numGroupsZ);
+    typedef void (APIENTRYP BindImageTextureProc)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+    typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+
+    DispatchComputeProc DispatchCompute = nullptr;
+    BindImageTextureProc BindImageTexture = nullptr;
+    // glMemoryBarrier, named so it doesn't clash with the MemoryBarrier macro of windows.h
+    MemoryBarrierProc Barrier = nullptr;
+    MultiDrawElementsIndirectProc MultiDrawElementsIndirect = nullptr;
+
+    static GLExt& Instance()
+    {
+        static GLExt ext;
+        return ext;
+    }
+
+    // call once after gladLoadGLLoader with the same loader. The context is requested as 3.3 core, but most drivers
+    // hand out the newest core profile they have, so the actual version decides what gets loaded.
+    void Load(GLADloadproc load)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major < 4 || (major == 4 && minor < 3))
+            return;
+        DispatchCompute = (DispatchComputeProc)load("glDispatchCompute");
+        BindImageTexture = (BindImageTextureProc)load("glBindImageTexture");
+        Barrier = (MemoryBarrierProc)load("glMemoryBarrier");
+        MultiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+    }
+
+    // compute shaders and image load/store, OpenGL 4.3
+    bool ComputeSupported() const
+    {
+        return DispatchCompute && BindImageTexture && Barrier;
+    }
+
+    // glMultiDrawElementsIndirect with a base instance in the commands, OpenGL 4.3
+    bool MultiDrawIndirectSupported() const
+    {
+        return MultiDrawElementsIndirect != nullptr;
+    }
+
+private:
+    GLExt() = default;
+};
+#endif
@@ -0,0 +1,210 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the OpenGL state the passes change most often: the program, the vertex array, the active
+// texture unit, the 2D / cube map texture of every unit, blending, depth test and face culling. Setting what is
+// already set returns without a GL call, and both the forwarded and the elided calls are counted for the profiler.
+// Code that changes state behind the cache's back (texture uploads, model loading) leaves it stale, so it is
+// invalidated once per frame before the scene is drawn and the first call of each kind after that always goes through.
+class GLState
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+    struct Counters {
+        unsigned long issued = 0;
+        unsigned long elided = 0;
+    };
+
+    static GLState& Instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    void UseProgram(unsigned int id)
+    {
+        if (elide(program, id))
+            return;
+        glUseProgram(id);
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (elide(vertexArray, id))
+            return;
+        glBindVertexArray(id);
+    }
+
+    // unit is 0 based, GL_TEXTURE0 + unit is made active
+    void ActiveTexture(unsigned int unit)
+    {
+        if (elide(activeUnit, unit))
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds texture to target on the given unit, which is left active when the binding changes
+    void BindTexture(unsigned int unit, GLenum target, unsigned int texture)
+    {
+        unsigned int untracked = UNKNOWN;
+        unsigned int *bound = &untracked;
+        if (unit < MAX_TEXTURE_UNITS && target == GL_TEXTURE_2D)
+            bound = &textures2D[unit];
+        else if (unit < MAX_TEXTURE_UNITS && target == GL_TEXTURE_CUBE_MAP)
+            bound = &texturesCube[unit];
+        if (elide(*bound, texture))
+            return;
+        ActiveTexture(unit);
+        glBindTexture(target, texture);
+    }
+
+    // GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are tracked, any other capability is always forwarded
+    void SetEnabled(GLenum capability, bool enabled)
+    {
+        unsigned int untracked = UNKNOWN;
+        unsigned int *current = capabilityState(capability);
+        if (elide(current ? *current : untracked, enabled ? 1u : 0u))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    // the cached value, or the driver's if the cache doesn't know it
+    bool IsEnabled(GLenum capability)
+    {
+        unsigned int *current = capabilityState(capability);
+        if (!current || *current == UNKNOWN)
+            return glIsEnabled(capability) == GL_TRUE;
+        return *current == 1;
+    }
+
+    void BlendFunc(GLenum source, GLenum destination)
+    {
+        // both factors are below 0x10000, one value holds the pair
+        if (elide(blendFunc, source << 16 | destination))
+            return;
+        glBlendFunc(source, destination);
+    }
+
+    // the cached blend factors, or the driver's if the cache doesn't know them
+    void GetBlendFunc(GLenum &source, GLenum &destination)
+    {
+        if (blendFunc == UNKNOWN)
+        {
+            GLint factor;
+            glGetIntegerv(GL_BLEND_SRC_RGB, &factor);
+            source = (GLenum)factor;
+            glGetIntegerv(GL_BLEND_DST_RGB, &factor);
+            destination = (GLenum)factor;
+            return;
+        }
+        source = blendFunc >> 16;
+        destination = blendFunc & 0xffff;
+    }
+
+    void DepthMask(bool write)
+    {
+        if (elide(depthMask, write ? 1u : 0u))
+            return;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void DepthFunc(GLenum function)
+    {
+        if (elide(depthFunc, function))
+            return;
+        glDepthFunc(function);
+    }
+
+    // GL_BACK or GL_FRONT, culling itself is switched with SetEnabled(GL_CULL_FACE)
+    void CullFace(GLenum face)
+    {
+        if (elide(cullMode, face))
+            return;
+        glCullFace(face);
+    }
+
+    // forgets all state, the next call of each kind reaches OpenGL
+    void Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+            textures2D[i] = texturesCube[i] = UNKNOWN;
+        blend = depthTest = cullFace = UNKNOWN;
+        blendFunc = depthMask = depthFunc = cullMode = UNKNOWN;
+    }
+
+    // starts counting a new frame and invalidates the cache, call once per frame before drawing the scene
+    void NewFrame()
+    {
+        lastFrame = frame;
+        frame = Counters();
+        Invalidate();
+    }
+
+    // calls of the last complete frame
+    const Counters& LastFrame() const
+    {
+        return lastFrame;
+    }
+
+    // calls of all frames so far
+    const Counters& Total() const
+    {
+        return total;
+    }
+
+private:
+    // no valid object name or enum value, so nothing compares equal to it
+    static const unsigned int UNKNOWN = ~0u;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int textures2D[MAX_TEXTURE_UNITS];
+    unsigned int texturesCube[MAX_TEXTURE_UNITS];
+    // 0 or 1
+    unsigned int blend, depthTest, cullFace;
+    unsigned int blendFunc, depthMask, depthFunc, cullMode;
+
+    Counters frame, lastFrame, total;
+
+    GLState()
+    {
+        Invalidate();
+    }
+
+    unsigned int* capabilityState(GLenum capability)
+    {
+        switch (capability)
+        {
+            case GL_BLEND: return &blend;
+            case GL_DEPTH_TEST: return &depthTest;
+            case GL_CULL_FACE: return &cullFace;
+            default: return nullptr;
+        }
+    }
+
+    // true if current already holds value, otherwise stores it; counts the call either way
+    bool elide(unsigned int &current, unsigned int value)
+    {
+        if (current == value && value != UNKNOWN)
+        {
+            frame.elided++;
+            total.elided++;
+            return true;
+        }
+        current = value;
+        frame.issued++;
+        total.issued++;
+        return false;
+    }
+};
+#endif
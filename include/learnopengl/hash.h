@@ -0,0 +1,21 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a. Not cryptographic, only used to detect changed or duplicated asset files.
+const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t seed = HASH_SEED)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+#endif
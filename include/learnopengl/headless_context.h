@@ -0,0 +1,150 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_ext.h>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// OpenGL 3.3 core context without a window or display, for benchmarks and regression runs on machines
+// without a GPU (Mesa llvmpipe). Uses an EGL surfaceless display, so there is no default framebuffer:
+// everything that would go to the window is rendered into Framebuffer() instead.
+// Only available when the build found EGL (HEADLESS_EGL), Create() fails otherwise.
+class HeadlessContext
+{
+public:
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    ~HeadlessContext()
+    {
+        Destroy();
+    }
+
+    // creates the context, makes it current, loads the GL functions and allocates the width x height color target
+    bool Create(unsigned int width, unsigned int height)
+    {
+#ifdef HEADLESS_EGL
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cout << "ERROR::HEADLESS:: could not initialize an EGL display" << std::endl;
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+        const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE};
+        // surfaceless contexts need no config (EGL_KHR_no_config_context)
+        context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            std::cout << "ERROR::HEADLESS:: could not create a surfaceless OpenGL 3.3 core context" << std::endl;
+            return false;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return false;
+        }
+        GLExt::Instance().Load((GLADloadproc)eglGetProcAddress);
+        createFramebuffer(width, height);
+        // without a surface the initial viewport is empty
+        glViewport(0, 0, width, height);
+        return true;
+#else
+        std::cout << "ERROR::HEADLESS:: built without EGL, headless mode is not available" << std::endl;
+        return false;
+#endif
+    }
+
+    // stands in for the window's default framebuffer
+    unsigned int Framebuffer() const
+    {
+        return framebuffer;
+    }
+
+    // writes the color target as a binary PPM
+    bool SaveScreenshot(const std::string &path) const
+    {
+        std::vector<unsigned char> pixels((size_t)width * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::HEADLESS:: could not write " << path << std::endl;
+            return false;
+        }
+        std::fprintf(file, "P6\n%u %u\n255\n", width, height);
+        // GL rows start at the bottom
+        for (unsigned int row = height; row-- > 0;)
+            std::fwrite(pixels.data() + (size_t)row * width * 3, 1, (size_t)width * 3, file);
+        std::fclose(file);
+        return true;
+    }
+
+    void Destroy()
+    {
+#ifdef HEADLESS_EGL
+        if (context == EGL_NO_CONTEXT)
+            return;
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        context = EGL_NO_CONTEXT;
+#endif
+    }
+
+private:
+#ifdef HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+    unsigned int framebuffer = 0;
+    unsigned int renderbuffers[2] = {0, 0};
+    unsigned int width = 0, height = 0;
+
+    void createFramebuffer(unsigned int width, unsigned int height)
+    {
+        this->width = width;
+        this->height = height;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HEADLESS:: offscreen framebuffer not complete!" << std::endl;
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,329 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// a point light as the fragment shader fetches it from the light buffer, four RGBA32F texels per light
+struct PointLight {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    // distance at which the light fades out, filled in by LightClusters from the attenuation
+    float radius;
+};
+
+// the part of the Lights uniform block the fragment shader needs to find its cluster, std140
+struct ClusterInfo {
+    // size of a cluster on screen in pixels
+    glm::vec2 tileSize;
+    // slice = log(view depth) * depthScale - depthBias
+    float depthScale;
+    float depthBias;
+    int gridX;
+    int gridY;
+    int gridZ;
+    int lightCount;
+};
+
+static_assert(sizeof(PointLight) == 64 && sizeof(ClusterInfo) == 32, "light structs must match the shader");
+
+// Clustered forward lighting. The view frustum is split into GRID_X x GRID_Y tiles on screen and GRID_Z slices in
+// depth (exponentially spaced, so clusters stay roughly cubic), and every frame the point lights are binned on the
+// CPU into the clusters their sphere of influence touches. The fragment shader finds its cluster from
+// gl_FragCoord and its view depth and only shades the lights listed there.
+//
+// Everything lives in texture buffers, which OpenGL 3.3 has (shader storage buffers would need 4.3):
+//   light data    : RGBA32F, the PointLight array
+//   clusters      : RG32UI, per cluster the offset of its first light index and the number of lights
+//   light indices : R32UI, the light lists of all clusters back to back
+class LightClusters
+{
+public:
+    static const unsigned int GRID_X = 16;
+    static const unsigned int GRID_Y = 9;
+    static const unsigned int GRID_Z = 24;
+    static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    // texture units of the three buffers, above the ones the materials use
+    static const unsigned int LIGHT_DATA_UNIT = 13;
+    static const unsigned int CLUSTER_UNIT = 14;
+    static const unsigned int LIGHT_INDEX_UNIT = 15;
+    // a light's radius ends where its brightest channel drops below this, the shader fades it out towards there
+    static constexpr float CUTOFF = 0.02f;
+
+    LightClusters()
+    {
+        // the guaranteed minimum is 65536 texels, lights beyond what fits are dropped from their clusters
+        GLint maxTexels = 65536;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxIndices = (unsigned int)std::min(maxTexels, 1 << 20);
+        maxLights = (unsigned int)std::min(maxTexels / 4, 1 << 16);
+
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for (int i = 0; i < 3; i++)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    ~LightClusters()
+    {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    // points the shader's lightData, lightClusters and lightIndices samplers at the buffer units
+    static void SetSamplers(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("lightData", LIGHT_DATA_UNIT);
+        shader.setInt("lightClusters", CLUSTER_UNIT);
+        shader.setInt("lightIndices", LIGHT_INDEX_UNIT);
+    }
+
+    // distance at which the light's brightest channel falls below CUTOFF
+    static float Radius(const PointLight &light)
+    {
+        glm::vec3 color = light.ambient + light.diffuse + light.specular;
+        float brightest = std::max(color.x, std::max(color.y, color.z));
+        // solve constant + linear * d + quadratic * d^2 = brightest / CUTOFF
+        float c = light.constant - brightest / CUTOFF;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (light.quadratic <= 0.0f)
+            return light.linear > 0.0f ? -c / light.linear : 1e30f;
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+    }
+
+    // bins the lights for this view and uploads the buffers. width and height are the size of the render target
+    // the clusters are drawn into, projection has to be a symmetric perspective with the given planes.
+    void Update(const std::vector<PointLight> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                float nearPlane, float farPlane, unsigned int width, unsigned int height)
+    {
+        float logRatio = std::log(farPlane / nearPlane);
+        info.tileSize = glm::vec2((float)width / GRID_X, (float)height / GRID_Y);
+        info.depthScale = GRID_Z / logRatio;
+        info.depthBias = GRID_Z * std::log(nearPlane) / logRatio;
+        info.gridX = GRID_X;
+        info.gridY = GRID_Y;
+        info.gridZ = GRID_Z;
+        buildBounds(projection, nearPlane, farPlane);
+
+        gpuLights.assign(lights.begin(), lights.begin() + std::min((size_t)maxLights, lights.size()));
+        info.lightCount = (int)gpuLights.size();
+        pairs.clear();
+        for (unsigned int i = 0; i < gpuLights.size(); i++)
+        {
+            PointLight &light = gpuLights[i];
+            light.radius = Radius(light);
+            binLight(i, glm::vec3(view * glm::vec4(light.position, 1.0f)), light.radius, projection, nearPlane, farPlane);
+        }
+
+        // counting sort of the (cluster, light) pairs into per-cluster lists
+        clusterRanges.assign(CLUSTER_COUNT * 2, 0);
+        for (const LightPair &pair : pairs)
+            clusterRanges[pair.cluster * 2 + 1]++;
+        unsigned int offset = 0;
+        maxPerCluster = 0;
+        for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            unsigned int &count = clusterRanges[cluster * 2 + 1];
+            count = std::min(count, maxIndices - offset);
+            clusterRanges[cluster * 2] = offset;
+            offset += count;
+            maxPerCluster = std::max(maxPerCluster, count);
+        }
+        indexCount = offset;
+        dropped = (unsigned int)pairs.size() - indexCount;
+        lightIndices.resize(std::max(indexCount, 1u));
+        fill.assign(CLUSTER_COUNT, 0);
+        for (const LightPair &pair : pairs)
+        {
+            unsigned int &filled = fill[pair.cluster];
+            if (filled < clusterRanges[pair.cluster * 2 + 1])
+                lightIndices[clusterRanges[pair.cluster * 2] + filled++] = pair.light;
+        }
+
+        upload(0, gpuLights.data(), std::max(gpuLights.size(), (size_t)1) * sizeof(PointLight));
+        upload(1, clusterRanges.data(), clusterRanges.size() * sizeof(unsigned int));
+        upload(2, lightIndices.data(), lightIndices.size() * sizeof(unsigned int));
+    }
+
+    // binds the three buffers to their units
+    void Bind() const
+    {
+        GLState &state = GLState::Instance();
+        const unsigned int units[3] = {LIGHT_DATA_UNIT, CLUSTER_UNIT, LIGHT_INDEX_UNIT};
+        for (int i = 0; i < 3; i++)
+            state.BindTexture(units[i], GL_TEXTURE_BUFFER, textures[i]);
+    }
+
+    const ClusterInfo& Info() const
+    {
+        return info;
+    }
+
+    // light indices of all clusters together, the most lights a single cluster got, and the ones that didn't fit
+    unsigned int IndexCount() const
+    {
+        return indexCount;
+    }
+
+    unsigned int MaxPerCluster() const
+    {
+        return maxPerCluster;
+    }
+
+    unsigned int Dropped() const
+    {
+        return dropped;
+    }
+
+private:
+    struct LightPair {
+        unsigned int cluster;
+        unsigned int light;
+    };
+
+    // view space bounds of a cluster
+    struct ClusterBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    unsigned int buffers[3];
+    unsigned int textures[3];
+    unsigned int maxIndices;
+    unsigned int maxLights;
+
+    ClusterInfo info = {};
+    std::vector<ClusterBounds> bounds;
+    std::vector<PointLight> gpuLights;
+    std::vector<LightPair> pairs;
+    std::vector<unsigned int> clusterRanges;
+    std::vector<unsigned int> lightIndices;
+    std::vector<unsigned int> fill;
+    unsigned int indexCount = 0;
+    unsigned int maxPerCluster = 0;
+    unsigned int dropped = 0;
+
+    // view depth where a slice starts
+    static float sliceDepth(unsigned int slice, float nearPlane, float farPlane)
+    {
+        return nearPlane * std::pow(farPlane / nearPlane, (float)slice / GRID_Z);
+    }
+
+    void buildBounds(const glm::mat4 &projection, float nearPlane, float farPlane)
+    {
+        bounds.resize(CLUSTER_COUNT);
+        // view space x and y at depth d are ndc * d / projection scale
+        float scaleX = 1.0f / projection[0][0];
+        float scaleY = 1.0f / projection[1][1];
+        for (unsigned int z = 0; z < GRID_Z; z++)
+        {
+            float depths[2] = {sliceDepth(z, nearPlane, farPlane), sliceDepth(z + 1, nearPlane, farPlane)};
+            for (unsigned int y = 0; y < GRID_Y; y++)
+            {
+                float ndcY[2] = {2.0f * y / GRID_Y - 1.0f, 2.0f * (y + 1) / GRID_Y - 1.0f};
+                for (unsigned int x = 0; x < GRID_X; x++)
+                {
+                    float ndcX[2] = {2.0f * x / GRID_X - 1.0f, 2.0f * (x + 1) / GRID_X - 1.0f};
+                    ClusterBounds &box = bounds[x + y * GRID_X + z * GRID_X * GRID_Y];
+                    box.min = glm::vec3(1e30f);
+                    box.max = glm::vec3(-1e30f);
+                    for (float depth : depths)
+                    {
+                        for (int corner = 0; corner < 4; corner++)
+                        {
+                            glm::vec3 point(ndcX[corner & 1] * depth * scaleX, ndcY[corner >> 1] * depth * scaleY, -depth);
+                            box.min = glm::min(box.min, point);
+                            box.max = glm::max(box.max, point);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // adds a pair for every cluster the sphere touches, center in view space
+    void binLight(unsigned int light, const glm::vec3 &center, float radius, const glm::mat4 &projection, float nearPlane, float farPlane)
+    {
+        float nearest = std::max(-center.z - radius, nearPlane);
+        float farthest = std::min(-center.z + radius, farPlane);
+        if (nearest > farthest)
+            return;
+        int firstSlice = slice(nearest);
+        int lastSlice = slice(farthest);
+
+        // the sphere's box seen from the camera: x / depth is monotonic in depth, so the extremes are at the ends
+        float ndc[4];
+        for (int axis = 0; axis < 2; axis++)
+        {
+            float scale = projection[axis][axis];
+            float low = center[axis] - radius, high = center[axis] + radius;
+            ndc[axis * 2] = scale * std::min(low / nearest, low / farthest);
+            ndc[axis * 2 + 1] = scale * std::max(high / nearest, high / farthest);
+        }
+        if (ndc[0] > 1.0f || ndc[1] < -1.0f || ndc[2] > 1.0f || ndc[3] < -1.0f)
+            return;
+        int firstX = tile(ndc[0], GRID_X), lastX = tile(ndc[1], GRID_X);
+        int firstY = tile(ndc[2], GRID_Y), lastY = tile(ndc[3], GRID_Y);
+
+        for (int z = firstSlice; z <= lastSlice; z++)
+        {
+            for (int y = firstY; y <= lastY; y++)
+            {
+                for (int x = firstX; x <= lastX; x++)
+                {
+                    unsigned int cluster = x + y * GRID_X + z * GRID_X * GRID_Y;
+                    const ClusterBounds &box = bounds[cluster];
+                    glm::vec3 offset = glm::clamp(center, box.min, box.max) - center;
+                    if (glm::dot(offset, offset) <= radius * radius)
+                        pairs.push_back({cluster, light});
+                }
+            }
+        }
+    }
+
+    int slice(float depth) const
+    {
+        int index = (int)std::floor(std::log(depth) * info.depthScale - info.depthBias);
+        return std::min(std::max(index, 0), (int)GRID_Z - 1);
+    }
+
+    static int tile(float ndc, unsigned int tiles)
+    {
+        int index = (int)std::floor((ndc + 1.0f) * 0.5f * tiles);
+        return std::min(std::max(index, 0), (int)tiles - 1);
+    }
+
+    void upload(int buffer, const void *data, size_t bytes)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+#endif
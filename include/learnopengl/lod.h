@@ -0,0 +1,99 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// levels of detail of a mesh, the full one included
+const unsigned int MAX_LOD_LEVELS = 4;
+
+// a coarser index buffer over the vertices of a mesh
+struct MeshLod {
+    std::vector<unsigned int> indices;
+    // how far the surface may have moved away from the full mesh, in object space units
+    float error = 0.0f;
+};
+
+// the same, wherever the indices live (e.g. a mapped mesh cache)
+struct MeshLodView {
+    const unsigned int *indices;
+    size_t indexCount;
+    float error;
+};
+
+// Chooses the level of detail of every placement from its size on screen. The placement's bounding sphere is
+// projected at the distance of its nearest point, and the coarsest level whose error, scaled like the radius,
+// stays below Tolerance pixels is drawn. Inside the sphere everything gets the full mesh.
+//
+// A placement right at a threshold would switch levels every frame as the camera moves by a pixel, so the level it
+// was drawn with last frame is kept while its error stays below the tolerance, and a coarser one is only taken once
+// its error is below HYSTERESIS times the tolerance.
+class LodSelector
+{
+public:
+    static constexpr float HYSTERESIS = 0.75f;
+
+    // placements per level and triangles queued since Begin, for the UI
+    struct Stats {
+        unsigned int placements[MAX_LOD_LEVELS] = {};
+        unsigned long triangles = 0;
+    };
+
+    // off draws every placement at the full level
+    bool Enabled = true;
+    // largest error allowed on screen, in pixels
+    float Tolerance = 1.0f;
+
+    // starts a frame seen from viewPosition, with the vertical field of view fovY (radians) over viewportHeight pixels
+    void Begin(const glm::vec3 &viewPosition, float fovY, float viewportHeight)
+    {
+        this->viewPosition = viewPosition;
+        pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+        stats = Stats();
+    }
+
+    // level of a placement of an object with the object space bounding sphere and the per level errors (errors[0]
+    // is the full mesh's, 0), current is the level it was drawn with last frame
+    unsigned int Select(const BoundingSphere &sphere, const glm::mat4 &transform, const float *errors, unsigned int levels,
+                        unsigned int current)
+    {
+        unsigned int level = 0;
+        BoundingSphere world = sphere.Transformed(transform);
+        float distance = glm::length(world.center - viewPosition) - world.radius;
+        if (Enabled && levels > 1 && distance > 0.0f && sphere.radius > 0.0f)
+        {
+            // screen pixels per object space unit
+            float pixels = pixelsPerUnit * world.radius / (sphere.radius * distance);
+            level = std::min(current, levels - 1);
+            while (level > 0 && errors[level] * pixels > Tolerance)
+                level--;
+            while (level + 1 < levels && errors[level + 1] * pixels < Tolerance * HYSTERESIS)
+                level++;
+        }
+        stats.placements[level]++;
+        return level;
+    }
+
+    void CountTriangles(unsigned long triangles)
+    {
+        stats.triangles += triangles;
+    }
+
+    const Stats& FrameStats() const
+    {
+        return stats;
+    }
+
+private:
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+    // screen pixels per world unit at a distance of 1
+    float pixelsPerUnit = 1.0f;
+    Stats stats;
+};
+#endif
@@ -6,26 +6,17 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/frustum.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/lod.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_loader.h>
 
 #include <string>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-};
-
-
 
 struct Texture {
     unsigned int id;
@@ -39,31 +30,128 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // object space bounds, computed from the vertices at load time
+    AABB bounds;
+    BoundingSphere boundingSphere;
 
-    unsigned int VAO;
+    // vertices and indices in the geometry arena
+    GeometryRange geometry;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, lods are the coarser index buffers over the same vertices
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, const vector<MeshLod> &lods = {})
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        // now that we have all the required data, copy it into the shared buffers
+        geometry = GeometryArena::Instance().Allocate(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        computeBounds(this->vertices.data(), this->vertices.size());
+        vector<MeshLodView> views;
+        for (const MeshLod &lod : lods)
+            views.push_back({lod.indices.data(), lod.indices.size(), lod.error});
+        allocateLods(views);
+    }
+
+    // constructor for data that already lives in memory in its final layout (e.g. a mapped mesh cache),
+    // the buffers are filled straight from the given pointers before the CPU copy is made.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures,
+         const vector<MeshLodView> &lods = {})
+    {
+        geometry = GeometryArena::Instance().Allocate(vertexData, vertexCount, indexData, indexCount);
+        computeBounds(vertexData, vertexCount);
+        allocateLods(lods);
+
+        this->vertices.assign(vertexData, vertexData + vertexCount);
+        this->indices.assign(indexData, indexData + indexCount);
+        this->textures = textures;
+    }
+
+    // lod 0 is the full mesh, a level the mesh doesn't have draws its coarsest one
+    DrawElementsIndirectCommand DrawCommand(unsigned int instanceCount, unsigned int baseInstance, unsigned int lod = 0) const
+    {
+        const GeometryRange &range = Level(lod);
+        return {range.indexCount, instanceCount, range.firstIndex, range.baseVertex, baseInstance};
+    }
+
+    // levels of detail, the full mesh included
+    unsigned int LodCount() const
+    {
+        return 1 + (unsigned int)lodGeometry.size();
+    }
+
+    const GeometryRange& Level(unsigned int lod) const
+    {
+        lod = std::min(lod, LodCount() - 1);
+        return lod == 0 ? geometry : lodGeometry[lod - 1];
+    }
+
+    // how far the level's surface may lie from the full mesh, in object space units
+    float LodError(unsigned int lod) const
+    {
+        lod = std::min(lod, LodCount() - 1);
+        return lod == 0 ? 0.0f : lodErrors[lod - 1];
+    }
+
+    // sets the samplers and binds the textures
+    void BindMaterial(Shader &shader)
+    {
+        // the sampler names only change with the program or the prefix, so they are resolved once and reused
+        if (shader.ID != samplerProgram || glslIdentifierPrefix != samplerPrefix)
+            resolveSamplers(shader);
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // set the sampler to the correct texture unit
+            shader.setInt(samplerHandles[i], i);
+            // and bind the texture to it, unless it is there already
+            GLState::Instance().BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // whether BindMaterial would bind the same textures to the same samplers, so both can share a draw call
+    bool SameMaterial(const Mesh &other) const
+    {
+        if (textures.size() != other.textures.size() || glslIdentifierPrefix != other.glslIdentifierPrefix)
+            return false;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type)
+                return false;
+        }
+        return true;
+    }
+
+    // whether no fragment of the mesh is ever discarded for its alpha, so its depth doesn't depend on the
+    // textures. False while a diffuse texture is still loading.
+    bool Opaque() const
+    {
+        for (const Texture &texture : textures)
+        {
+            if (texture.type == "texture_diffuse" && !TextureLoader::Instance().IsOpaque(texture.id))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    // the coarser levels, their indices over the vertices of geometry
+    vector<GeometryRange> lodGeometry;
+    vector<float> lodErrors;
+
+    // sampler locations of the textures for the program they were looked up in
+    vector<UniformHandle> samplerHandles;
+    unsigned int samplerProgram = 0;
+    std::string samplerPrefix;
+
+    void resolveSamplers(Shader &shader)
     {
-        // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerHandles.clear();
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,65 +163,38 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerHandles.push_back(shader.uniform(glslIdentifierPrefix + name + number));
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        samplerProgram = shader.ID;
+        samplerPrefix = glslIdentifierPrefix;
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    void allocateLods(const vector<MeshLodView> &lods)
+    {
+        for (const MeshLodView &lod : lods)
+        {
+            if (lodGeometry.size() + 1 >= MAX_LOD_LEVELS)
+                break;
+            lodGeometry.push_back(GeometryArena::Instance().AllocateIndices(lod.indices, lod.indexCount, geometry.baseVertex));
+            lodErrors.push_back(lod.error);
+        }
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // box around all vertices, and a sphere around the box center that encloses every vertex
+    void computeBounds(const Vertex *vertexData, size_t vertexCount)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        for (size_t i = 0; i < vertexCount; i++)
+            bounds.Extend(vertexData[i].Position);
+        if (bounds.Empty())
+            return;
+        boundingSphere.center = bounds.Center();
+        float radiusSquared = 0.0f;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            glm::vec3 offset = vertexData[i].Position - boundingSphere.center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        boundingSphere.radius = std::sqrt(radiusSquared);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,248 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary "cooked" form of a model, written next to the source as <model>.obj.rgmesh.
+// All values are stored in host (little-endian) byte order:
+//
+//   header   : "RGMC", version, sizeof(Vertex), mesh count, 64-bit hash of the .obj and its .mtl files
+//   per mesh : vertex count, index count, texture count, level of detail count
+//              texture references (type and path, each length-prefixed, padded to 4 bytes)
+//              interleaved Vertex array, unsigned int index array
+//              per level of detail: index count, float error, unsigned int index array
+//
+// Bump MESH_CACHE_VERSION whenever the layout, the ASSIMP post-processing flags in Model or the simplification
+// change, the old caches are then treated as misses and rebuilt.
+const uint32_t MESH_CACHE_VERSION = 2;
+
+static_assert(std::is_trivially_copyable<Vertex>::value, "Vertex is written to the mesh cache byte by byte");
+
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// CPU side mesh as produced by the importer, before anything is uploaded to the GPU
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<TextureRef>   textures;
+    // coarser index buffers over the same vertices, from MeshSimplifier
+    vector<MeshLod>      lods;
+};
+
+class MeshCache
+{
+public:
+    // view of a mesh inside the mapped cache file, valid while the MeshCache is alive
+    struct MeshView {
+        const Vertex       *vertices;
+        uint32_t            vertexCount;
+        const unsigned int *indices;
+        uint32_t            indexCount;
+        vector<TextureRef>  textures;
+        vector<MeshLodView> lods;
+    };
+
+    static string CachePath(const string &sourcePath)
+    {
+        return sourcePath + ".rgmesh";
+    }
+
+    // hashes the .obj together with every material library it references, so editing either invalidates the cache
+    static uint64_t SourceHash(const string &sourcePath)
+    {
+        uint64_t hash = HashBytes(&MESH_CACHE_VERSION, sizeof(MESH_CACHE_VERSION));
+        MappedFile source;
+        if (!source.Open(sourcePath))
+            return hash;
+        hash = HashBytes(source.Data(), source.Size(), hash);
+
+        string directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+        std::istringstream lines(string(reinterpret_cast<const char*>(source.Data()), source.Size()));
+        string line;
+        while (std::getline(lines, line))
+        {
+            if (line.compare(0, 7, "mtllib ") != 0)
+                continue;
+            string library = line.substr(7);
+            while (!library.empty() && (library.back() == '\r' || library.back() == ' '))
+                library.pop_back();
+            MappedFile material;
+            if (material.Open(directory + '/' + library))
+                hash = HashBytes(material.Data(), material.Size(), hash);
+        }
+        return hash;
+    }
+
+    static bool Write(const string &cachePath, uint64_t sourceHash, const vector<MeshData> &meshes)
+    {
+        // write to a temporary file first so an interrupted cook never leaves a truncated cache behind
+        string tempPath = cachePath + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        out.write(MAGIC, 4);
+        writeU32(out, MESH_CACHE_VERSION);
+        writeU32(out, (uint32_t)sizeof(Vertex));
+        writeU32(out, (uint32_t)meshes.size());
+        out.write(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash));
+        for (const MeshData &mesh : meshes)
+        {
+            writeU32(out, (uint32_t)mesh.vertices.size());
+            writeU32(out, (uint32_t)mesh.indices.size());
+            writeU32(out, (uint32_t)mesh.textures.size());
+            writeU32(out, (uint32_t)mesh.lods.size());
+            for (const TextureRef &texture : mesh.textures)
+            {
+                writeU32(out, (uint32_t)texture.type.size());
+                writeU32(out, (uint32_t)texture.path.size());
+                out.write(texture.type.data(), texture.type.size());
+                out.write(texture.path.data(), texture.path.size());
+                static const char padding[4] = {0, 0, 0, 0};
+                out.write(padding, (4 - (texture.type.size() + texture.path.size()) % 4) % 4);
+            }
+            out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+            out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+            for (const MeshLod &lod : mesh.lods)
+            {
+                writeU32(out, (uint32_t)lod.indices.size());
+                out.write(reinterpret_cast<const char*>(&lod.error), sizeof(lod.error));
+                out.write(reinterpret_cast<const char*>(lod.indices.data()), lod.indices.size() * sizeof(unsigned int));
+            }
+        }
+        out.close();
+        if (!out || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+            std::cout << "ERROR::MESH_CACHE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // maps the cache file and validates it against the current source hash. Returns false on any mismatch.
+    bool Open(const string &cachePath, uint64_t sourceHash)
+    {
+        views.clear();
+        if (!file.Open(cachePath))
+            return false;
+        const unsigned char *cursor = file.Data();
+        const unsigned char *end = file.Data() + file.Size();
+
+        uint32_t version, vertexSize, meshCount;
+        uint64_t hash;
+        if (!has(cursor, end, 4) || std::memcmp(cursor, MAGIC, 4) != 0)
+            return fail();
+        cursor += 4;
+        if (!readU32(cursor, end, version) || !readU32(cursor, end, vertexSize) || !readU32(cursor, end, meshCount))
+            return fail();
+        if (!has(cursor, end, sizeof(hash)))
+            return fail();
+        std::memcpy(&hash, cursor, sizeof(hash));
+        cursor += sizeof(hash);
+        if (version != MESH_CACHE_VERSION || vertexSize != sizeof(Vertex) || hash != sourceHash)
+            return fail();
+
+        for (uint32_t i = 0; i < meshCount; i++)
+        {
+            MeshView view;
+            uint32_t textureCount, lodCount;
+            if (!readU32(cursor, end, view.vertexCount) || !readU32(cursor, end, view.indexCount) || !readU32(cursor, end, textureCount) ||
+                !readU32(cursor, end, lodCount))
+                return fail();
+            for (uint32_t j = 0; j < textureCount; j++)
+            {
+                uint32_t typeLength, pathLength;
+                if (!readU32(cursor, end, typeLength) || !readU32(cursor, end, pathLength))
+                    return fail();
+                size_t padded = typeLength + pathLength;
+                padded += (4 - padded % 4) % 4;
+                if (!has(cursor, end, padded))
+                    return fail();
+                TextureRef texture;
+                texture.type.assign(reinterpret_cast<const char*>(cursor), typeLength);
+                texture.path.assign(reinterpret_cast<const char*>(cursor) + typeLength, pathLength);
+                view.textures.push_back(texture);
+                cursor += padded;
+            }
+            size_t vertexBytes = (size_t)view.vertexCount * sizeof(Vertex);
+            size_t indexBytes = (size_t)view.indexCount * sizeof(unsigned int);
+            if (!has(cursor, end, vertexBytes + indexBytes))
+                return fail();
+            view.vertices = reinterpret_cast<const Vertex*>(cursor);
+            view.indices = reinterpret_cast<const unsigned int*>(cursor + vertexBytes);
+            cursor += vertexBytes + indexBytes;
+            for (uint32_t j = 0; j < lodCount; j++)
+            {
+                uint32_t lodIndexCount;
+                MeshLodView lod;
+                if (!readU32(cursor, end, lodIndexCount) || !has(cursor, end, sizeof(lod.error)))
+                    return fail();
+                std::memcpy(&lod.error, cursor, sizeof(lod.error));
+                cursor += sizeof(lod.error);
+                if (!has(cursor, end, (size_t)lodIndexCount * sizeof(unsigned int)))
+                    return fail();
+                lod.indices = reinterpret_cast<const unsigned int*>(cursor);
+                lod.indexCount = lodIndexCount;
+                cursor += (size_t)lodIndexCount * sizeof(unsigned int);
+                view.lods.push_back(lod);
+            }
+            views.push_back(view);
+        }
+        return true;
+    }
+
+    const vector<MeshView>& Meshes() const
+    {
+        return views;
+    }
+
+private:
+    static constexpr const char *MAGIC = "RGMC";
+
+    MappedFile file;
+    vector<MeshView> views;
+
+    bool fail()
+    {
+        views.clear();
+        file.Close();
+        return false;
+    }
+
+    static bool has(const unsigned char *cursor, const unsigned char *end, size_t bytes)
+    {
+        return (size_t)(end - cursor) >= bytes;
+    }
+
+    static bool readU32(const unsigned char *&cursor, const unsigned char *end, uint32_t &value)
+    {
+        if (!has(cursor, end, sizeof(value)))
+            return false;
+        std::memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return true;
+    }
+
+    static void writeU32(std::ofstream &out, uint32_t value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+};
+#endif
@@ -0,0 +1,441 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/lod.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Builds the coarser levels of detail of a mesh with edge collapses ordered by their quadric error (Garland and
+// Heckbert, "Surface Simplification Using Quadric Error Metrics"). Every point carries the sum of the squared
+// distances to the planes of the triangles around it, and the edge whose collapse adds the least to that sum goes
+// first. A collapse moves one end onto the other, so the levels are index buffers over the mesh's own vertices and
+// share its vertex data in the arena.
+//
+// Vertices are welded by position, the importer gives every corner of a face its own. Borders and texture seams
+// stay in place: their points only move along them, held by extra planes through the edge, and where several meet
+// the point doesn't move at all. Normals are not kept apart, a moved corner takes the vertex at its new place whose
+// normal fits the triangle best.
+class MeshSimplifier
+{
+public:
+    // up to MAX_LOD_LEVELS - 1 levels with about half the triangles of the one before each. A level that doesn't get
+    // below three quarters of the previous one, or would move the surface by more than a tenth of the mesh's radius,
+    // isn't worth drawing and ends the chain.
+    static std::vector<MeshLod> BuildLods(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    {
+        MeshSimplifier simplifier(vertices, indices);
+        return simplifier.run();
+    }
+
+private:
+    // weight of the planes holding borders and seams, against 1 for a triangle's plane
+    static constexpr double BORDER_WEIGHT = 10.0;
+    // cosine of the largest turn a triangle's normal may take in a collapse, beyond it the collapse folds the surface
+    static constexpr float MIN_NORMAL_COSINE = 0.25f;
+    static constexpr float MAX_RELATIVE_ERROR = 0.1f;
+    static constexpr float MIN_REDUCTION = 0.75f;
+
+    // symmetric 4x4 matrix, the sum of the squared distances of a point to a set of planes
+    struct Quadric {
+        double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+
+        // the plane of points p with dot(normal, p) + distance = 0, normal of unit length
+        void AddPlane(const glm::vec3 &normal, float distance, double weight)
+        {
+            double a = normal.x, b = normal.y, c = normal.z, d = distance;
+            xx += weight * a * a; xy += weight * a * b; xz += weight * a * c; xw += weight * a * d;
+            yy += weight * b * b; yz += weight * b * c; yw += weight * b * d;
+            zz += weight * c * c; zw += weight * c * d;
+            ww += weight * d * d;
+        }
+
+        void Add(const Quadric &other)
+        {
+            xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+            yy += other.yy; yz += other.yz; yw += other.yw;
+            zz += other.zz; zw += other.zw;
+            ww += other.ww;
+        }
+
+        double Error(const glm::vec3 &point) const
+        {
+            double x = point.x, y = point.y, z = point.z;
+            double error = xx * x * x + yy * y * y + zz * z * z + ww
+                         + 2.0 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z);
+            // rounding can take a sum of squares below zero
+            return std::max(error, 0.0);
+        }
+    };
+
+    // moving point from onto point to
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        // versions of both points when the cost was computed, the candidate is stale once either changed
+        unsigned int fromVersion, toVersion;
+
+        bool operator>(const Collapse &other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    const std::vector<Vertex> &vertices;
+    // per vertex the welded point it sits on, and its wedge: the vertices with the same position and texture
+    // coordinates. Those only split by their normals (the corners of a flat shaded mesh) are one to the topology.
+    std::vector<unsigned int> pointOf;
+    std::vector<unsigned int> wedgeOf;
+    std::vector<glm::vec3> points;
+    std::vector<Quadric> quadrics;
+    // per point the triangles using it, dead ones are dropped when the point is collapsed onto
+    std::vector<std::vector<unsigned int>> fans;
+    std::vector<unsigned int> versions;
+    std::vector<uint8_t> removed;
+    // corners as vertex indices, the collapses rewrite them
+    std::vector<std::array<unsigned int, 3>> triangles;
+    // as imported, the collapses keep every triangle close to it
+    std::vector<glm::vec3> normals;
+    std::vector<uint8_t> alive;
+    size_t liveTriangles = 0;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> candidates;
+
+    MeshSimplifier(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices) : vertices(vertices)
+    {
+        std::map<std::array<uint32_t, 3>, unsigned int> pointIds;
+        std::map<std::array<uint32_t, 5>, unsigned int> wedgeIds;
+        pointOf.resize(vertices.size());
+        wedgeOf.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &vertex = vertices[i];
+            std::array<uint32_t, 5> key;
+            std::memcpy(&key[0], &vertex.Position, sizeof(uint32_t) * 3);
+            std::memcpy(&key[3], &vertex.TexCoords, sizeof(uint32_t) * 2);
+            std::array<uint32_t, 3> position = {{key[0], key[1], key[2]}};
+            auto point = pointIds.insert({position, (unsigned int)points.size()});
+            if (point.second)
+                points.push_back(vertex.Position);
+            pointOf[i] = point.first->second;
+            wedgeOf[i] = wedgeIds.insert({key, (unsigned int)wedgeIds.size()}).first->second;
+        }
+        quadrics.resize(points.size());
+        fans.resize(points.size());
+        versions.assign(points.size(), 0);
+        removed.assign(points.size(), 0);
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            std::array<unsigned int, 3> triangle = {{indices[i], indices[i + 1], indices[i + 2]}};
+            if (triangle[0] >= vertices.size() || triangle[1] >= vertices.size() || triangle[2] >= vertices.size())
+                continue;
+            // triangles without an area can't be seen, they are left out of every level
+            glm::vec3 normal;
+            if (!unitNormal(points[pointOf[triangle[0]]], points[pointOf[triangle[1]]], points[pointOf[triangle[2]]], normal))
+                continue;
+            unsigned int id = (unsigned int)triangles.size();
+            triangles.push_back(triangle);
+            normals.push_back(normal);
+            alive.push_back(1);
+            for (unsigned int corner : triangle)
+            {
+                unsigned int point = pointOf[corner];
+                fans[point].push_back(id);
+                quadrics[point].AddPlane(normal, -glm::dot(normal, points[point]), 1.0);
+            }
+        }
+        liveTriangles = triangles.size();
+
+        // every open edge gets a plane through it, upright on its triangle, so its points stay on the border
+        for (unsigned int t = 0; t < triangles.size(); t++)
+        {
+            const glm::vec3 &normal = normals[t];
+            for (unsigned int corner = 0; corner < 3; corner++)
+            {
+                unsigned int a = pointOf[triangles[t][corner]], b = pointOf[triangles[t][(corner + 1) % 3]];
+                if (!openEdge(a, b))
+                    continue;
+                glm::vec3 edgeNormal = glm::cross(points[b] - points[a], normal);
+                float length = glm::length(edgeNormal);
+                if (length == 0.0f)
+                    continue;
+                edgeNormal = edgeNormal / length;
+                quadrics[a].AddPlane(edgeNormal, -glm::dot(edgeNormal, points[a]), BORDER_WEIGHT);
+                quadrics[b].AddPlane(edgeNormal, -glm::dot(edgeNormal, points[a]), BORDER_WEIGHT);
+            }
+        }
+    }
+
+    std::vector<MeshLod> run()
+    {
+        std::vector<MeshLod> lods;
+        if (triangles.empty())
+            return lods;
+
+        std::vector<std::pair<unsigned int, unsigned int>> edges;
+        for (const std::array<unsigned int, 3> &triangle : triangles)
+        {
+            for (unsigned int corner = 0; corner < 3; corner++)
+            {
+                unsigned int a = pointOf[triangle[corner]], b = pointOf[triangle[(corner + 1) % 3]];
+                edges.push_back({std::min(a, b), std::max(a, b)});
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        for (const std::pair<unsigned int, unsigned int> &edge : edges)
+            consider(edge.first, edge.second);
+
+        AABB bounds;
+        for (const glm::vec3 &point : points)
+            bounds.Extend(point);
+        float radius = 0.5f * glm::length(bounds.max - bounds.min);
+        double maxCost = (double)MAX_RELATIVE_ERROR * radius * MAX_RELATIVE_ERROR * radius;
+
+        double worst = 0.0;
+        size_t previous = liveTriangles;
+        while (lods.size() + 1 < MAX_LOD_LEVELS)
+        {
+            size_t target = previous / 2;
+            while (liveTriangles > target && !candidates.empty() && candidates.top().cost <= maxCost)
+            {
+                Collapse collapse = candidates.top();
+                candidates.pop();
+                if (removed[collapse.from] || removed[collapse.to] || versions[collapse.from] != collapse.fromVersion ||
+                    versions[collapse.to] != collapse.toVersion)
+                    continue;
+                if (apply(collapse.from, collapse.to))
+                    worst = std::max(worst, collapse.cost);
+            }
+            if (liveTriangles > previous * MIN_REDUCTION)
+                break;
+            MeshLod lod;
+            lod.error = (float)std::sqrt(worst);
+            lod.indices.reserve(liveTriangles * 3);
+            for (unsigned int t = 0; t < triangles.size(); t++)
+            {
+                if (alive[t])
+                    lod.indices.insert(lod.indices.end(), triangles[t].begin(), triangles[t].end());
+            }
+            lods.push_back(std::move(lod));
+            previous = liveTriangles;
+        }
+        return lods;
+    }
+
+    // queues the cheaper direction of collapsing the edge between two points, if either is allowed
+    void consider(unsigned int a, unsigned int b)
+    {
+        double ab = cost(a, b), ba = cost(b, a);
+        if (ab >= 0.0 && (ba < 0.0 || ab <= ba))
+            candidates.push({ab, a, b, versions[a], versions[b]});
+        else if (ba >= 0.0)
+            candidates.push({ba, b, a, versions[b], versions[a]});
+    }
+
+    // error of moving point from onto point to, negative if that would pull a border or seam out of place
+    double cost(unsigned int from, unsigned int to) const
+    {
+        unsigned int open = openEdges(from);
+        if (open != 0 && (open != 2 || !openEdge(from, to)))
+            return -1.0;
+        Quadric quadric = quadrics[from];
+        quadric.Add(quadrics[to]);
+        return quadric.Error(points[to]);
+    }
+
+    // collapses the edge unless that folds a triangle over, tears a seam or makes the surface non-manifold
+    bool apply(unsigned int from, unsigned int to)
+    {
+        if (cost(from, to) < 0.0)
+            return false;
+        // the triangles on the edge go away. Their corners tell which wedge of to takes the place of each wedge of
+        // from, and their third points are the only ones both ends may share.
+        std::vector<std::pair<unsigned int, unsigned int>> wedges;
+        std::vector<unsigned int> shared;
+        for (unsigned int t : fans[from])
+        {
+            int at = corner(t, to);
+            if (!alive[t] || at < 0)
+                continue;
+            int atFrom = corner(t, from);
+            wedges.push_back({wedgeOf[triangles[t][atFrom]], wedgeOf[triangles[t][at]]});
+            shared.push_back(pointOf[triangles[t][3 - at - atFrom]]);
+        }
+        if (wedges.empty())
+            return false;
+
+        // the other triangles of from move their corner onto to, each gets the vertex there that suits it best
+        std::vector<unsigned int> neighbours = neighbourPoints(to);
+        std::vector<std::pair<unsigned int, unsigned int>> moves;
+        for (unsigned int t : fans[from])
+        {
+            if (!alive[t] || corner(t, to) >= 0)
+                continue;
+            int atFrom = corner(t, from);
+            unsigned int wedge = replacement(wedges, wedgeOf[triangles[t][atFrom]]);
+            if (wedge == ~0u)
+                return false;
+            for (unsigned int other = 1; other < 3; other++)
+            {
+                unsigned int point = pointOf[triangles[t][(atFrom + other) % 3]];
+                if (std::find(neighbours.begin(), neighbours.end(), point) != neighbours.end() &&
+                    std::find(shared.begin(), shared.end(), point) == shared.end())
+                    return false;
+            }
+            // neither against the triangle as it is nor as it was imported may the normal turn too far
+            glm::vec3 before, after;
+            glm::vec3 moved[3] = {position(t, 0), position(t, 1), position(t, 2)};
+            if (!unitNormal(moved[0], moved[1], moved[2], before))
+                return false;
+            moved[atFrom] = points[to];
+            if (!unitNormal(moved[0], moved[1], moved[2], after) || glm::dot(before, after) < MIN_NORMAL_COSINE ||
+                glm::dot(normals[t], after) < MIN_NORMAL_COSINE)
+                return false;
+            moves.push_back({t, closestVertex(to, wedge, after)});
+        }
+
+        for (unsigned int t : fans[from])
+        {
+            if (alive[t] && corner(t, to) >= 0)
+            {
+                alive[t] = 0;
+                liveTriangles--;
+            }
+        }
+        for (const std::pair<unsigned int, unsigned int> &move : moves)
+        {
+            triangles[move.first][corner(move.first, from)] = move.second;
+            fans[to].push_back(move.first);
+        }
+        fans[from].clear();
+        fans[to].erase(std::remove_if(fans[to].begin(), fans[to].end(), [this](unsigned int t) { return !alive[t]; }),
+                       fans[to].end());
+        quadrics[to].Add(quadrics[from]);
+        removed[from] = 1;
+        versions[to]++;
+        for (unsigned int neighbour : neighbourPoints(to))
+            consider(to, neighbour);
+        return true;
+    }
+
+    // the wedge of the far end that takes the place of wedge, ~0u if the edge's triangles have none for it
+    static unsigned int replacement(const std::vector<std::pair<unsigned int, unsigned int>> &wedges, unsigned int wedge)
+    {
+        for (const std::pair<unsigned int, unsigned int> &entry : wedges)
+        {
+            if (entry.first == wedge)
+                return entry.second;
+        }
+        return ~0u;
+    }
+
+    // the vertex of the wedge on point whose normal is closest to normal, a flat shaded mesh has one per face there
+    unsigned int closestVertex(unsigned int point, unsigned int wedge, const glm::vec3 &normal) const
+    {
+        unsigned int closest = ~0u;
+        float closestCosine = -2.0f;
+        for (unsigned int t : fans[point])
+        {
+            if (!alive[t])
+                continue;
+            unsigned int vertex = triangles[t][corner(t, point)];
+            float cosine = glm::dot(vertices[vertex].Normal, normal);
+            if (wedgeOf[vertex] == wedge && cosine > closestCosine)
+            {
+                closest = vertex;
+                closestCosine = cosine;
+            }
+        }
+        return closest;
+    }
+
+    // whether the edge between two points is a border or a seam: not shared by exactly two triangles that agree on
+    // the wedges at both ends
+    bool openEdge(unsigned int a, unsigned int b) const
+    {
+        unsigned int count = 0;
+        unsigned int wedgeA = 0, wedgeB = 0;
+        for (unsigned int t : fans[a])
+        {
+            int atB = corner(t, b);
+            if (!alive[t] || atB < 0)
+                continue;
+            unsigned int nextA = wedgeOf[triangles[t][corner(t, a)]], nextB = wedgeOf[triangles[t][atB]];
+            if (count > 0 && (nextA != wedgeA || nextB != wedgeB))
+                return true;
+            wedgeA = nextA;
+            wedgeB = nextB;
+            count++;
+        }
+        return count != 2;
+    }
+
+    // 0 inside a smooth surface, 2 on a border or seam, any other number where they meet or branch
+    unsigned int openEdges(unsigned int point) const
+    {
+        unsigned int open = 0;
+        for (unsigned int neighbour : neighbourPoints(point))
+        {
+            if (openEdge(point, neighbour))
+                open++;
+        }
+        return open;
+    }
+
+    std::vector<unsigned int> neighbourPoints(unsigned int point) const
+    {
+        std::vector<unsigned int> neighbours;
+        for (unsigned int t : fans[point])
+        {
+            if (!alive[t])
+                continue;
+            for (unsigned int vertex : triangles[t])
+            {
+                unsigned int other = pointOf[vertex];
+                if (other != point && std::find(neighbours.begin(), neighbours.end(), other) == neighbours.end())
+                    neighbours.push_back(other);
+            }
+        }
+        return neighbours;
+    }
+
+    // index of the triangle's corner on point, -1 if it has none there
+    int corner(unsigned int triangle, unsigned int point) const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (pointOf[triangles[triangle][i]] == point)
+                return i;
+        }
+        return -1;
+    }
+
+    const glm::vec3& position(unsigned int triangle, unsigned int corner) const
+    {
+        return points[pointOf[triangles[triangle][corner]]];
+    }
+
+    // false for a triangle without an area
+    static bool unitNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, glm::vec3 &normal)
+    {
+        normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            return false;
+        normal = normal / length;
+        return true;
+    }
+};
+#endif
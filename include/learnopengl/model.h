@@ -10,8 +10,14 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/frustum.h>
+#include <learnopengl/lod.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_simplify.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_registry.h>
 
 #include <string>
 #include <fstream>
@@ -30,22 +36,75 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// textures this model holds a TextureRegistry reference to, released in the destructor.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // object space bounds of all meshes together
+    AABB bounds;
+    BoundingSphere boundingSphere;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
         loadModel(path);
+        computeBounds();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // the texture references are owned by this instance, so it can't be copied
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    ~Model()
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        for (const Texture &texture : textures_loaded)
+            TextureRegistry::Instance().Release(texture.id);
+    }
+
+    // culls the placements against the model bounds and adds the visible ones to the arena's instances, then queues
+    // one packet per visible mesh and level of detail. The shader has to read the model matrix from the per-instance
+    // attribute at location 5. lods picks the level of every placement, levels holds the one each placement was
+    // drawn with last frame (0 at first) and is updated.
+    void Queue(RenderQueue &queue, Shader &shader, const glm::mat4 *transforms, size_t count, const Frustum &frustum,
+               LodSelector &lods, uint8_t *levels, CullStats &stats)
+    {
+        if (!cullInstances(transforms, count, frustum, stats))
+            return;
+        for (vector<glm::mat4> &placements : levelTransforms)
+            placements.clear();
+        for (size_t i = 0; i < visibleTransforms.size(); i++)
+        {
+            uint8_t &level = levels[visiblePlacements[i]];
+            level = (uint8_t)lods.Select(boundingSphere, visibleTransforms[i], lodErrors.data(), (unsigned int)lodErrors.size(), level);
+            levelTransforms[level].push_back(visibleTransforms[i]);
+        }
+        for (unsigned int level = 0; level < MAX_LOD_LEVELS; level++)
+        {
+            const vector<glm::mat4> &placements = levelTransforms[level];
+            if (placements.empty())
+                continue;
+            unsigned int baseInstance = GeometryArena::Instance().AddInstances(placements.data(), placements.size());
+            // the nearest placement decides the depth of all of them
+            float depth = 1e30f;
+            for (const glm::mat4 &transform : placements)
+                depth = std::min(depth, queue.Depth(glm::vec3(transform[3])));
+            for (Mesh &mesh : meshes)
+            {
+                if (!meshVisible(mesh, frustum))
+                    continue;
+                DrawPacket packet;
+                // meshes are told apart by their first texture, the one that changes between materials
+                unsigned int material = mesh.textures.empty() ? 0 : mesh.textures[0].id;
+                packet.key = RenderQueue::MakeKey(PASS_OPAQUE, shader.ID, material, depth);
+                packet.shader = &shader;
+                packet.mesh = &mesh;
+                packet.instanceCount = (unsigned int)placements.size();
+                packet.baseInstance = baseInstance;
+                packet.lod = level;
+                queue.Push(packet);
+                lods.CountTriangles((unsigned long)mesh.Level(level).indexCount / 3 * placements.size());
+            }
+        }
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
@@ -53,9 +112,104 @@ public:
             mesh.glslIdentifierPrefix = prefix;
         }
     }
+    // runs the offline part of loading (ASSIMP import) and stores the result in the mesh cache.
+    // Does not touch OpenGL, so it can be used from tools without a context.
+    static bool Cook(string const &path, bool force = false)
+    {
+        uint64_t sourceHash = MeshCache::SourceHash(path);
+        MeshCache cache;
+        if (!force && cache.Open(MeshCache::CachePath(path), sourceHash))
+            return true;
+        vector<MeshData> meshData;
+        if (!importModel(path, meshData))
+            return false;
+        return MeshCache::Write(MeshCache::CachePath(path), sourceHash, meshData);
+    }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // placements that passed the frustum test this draw and their indices, kept to avoid allocating every frame
+    vector<glm::mat4> visibleTransforms;
+    vector<unsigned int> visiblePlacements;
+    // the visible placements sorted by level of detail
+    vector<glm::mat4> levelTransforms[MAX_LOD_LEVELS];
+    // per level of detail the largest error of any mesh, what the model's placements are chosen by
+    vector<float> lodErrors;
+
+    void computeBounds()
+    {
+        for (const Mesh &mesh : meshes)
+        {
+            bounds.Extend(mesh.bounds);
+            lodErrors.resize(std::max(lodErrors.size(), (size_t)mesh.LodCount()), 0.0f);
+        }
+        for (unsigned int level = 0; level < lodErrors.size(); level++)
+        {
+            for (const Mesh &mesh : meshes)
+                lodErrors[level] = std::max(lodErrors[level], mesh.LodError(level));
+        }
+        if (bounds.Empty())
+            return;
+        boundingSphere.center = bounds.Center();
+        for (const Mesh &mesh : meshes)
+            boundingSphere.radius = std::max(boundingSphere.radius, glm::length(mesh.boundingSphere.center - boundingSphere.center) + mesh.boundingSphere.radius);
+    }
+
+    // collects the placements inside the frustum into visibleTransforms, false if there are none
+    bool cullInstances(const glm::mat4 *transforms, size_t count, const Frustum &frustum, CullStats &stats)
+    {
+        visibleTransforms.clear();
+        visiblePlacements.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            bool visible = frustum.Intersects(bounds, boundingSphere, transforms[i]);
+            stats.Count(visible);
+            if (visible)
+            {
+                visibleTransforms.push_back(transforms[i]);
+                visiblePlacements.push_back((unsigned int)i);
+            }
+        }
+        return !visibleTransforms.empty();
+    }
+
+    // whether any of visibleTransforms shows the mesh
+    bool meshVisible(const Mesh &mesh, const Frustum &frustum) const
+    {
+        // a single mesh covers the whole model, which already passed
+        if (meshes.size() == 1)
+            return true;
+        for (const glm::mat4 &transform : visibleTransforms)
+        {
+            if (frustum.Intersects(mesh.bounds, mesh.boundingSphere, transform))
+                return true;
+        }
+        return false;
+    }
+
+    // loads a model from its mesh cache, ASSIMP only runs (and refreshes the cache) when the cache is missing or stale.
     void loadModel(string const &path)
+    {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        uint64_t sourceHash = MeshCache::SourceHash(path);
+        MeshCache cache;
+        if (cache.Open(MeshCache::CachePath(path), sourceHash))
+        {
+            for (const MeshCache::MeshView &view : cache.Meshes())
+                meshes.push_back(Mesh(view.vertices, view.vertexCount, view.indices, view.indexCount, loadTextures(view.textures), view.lods));
+            return;
+        }
+
+        vector<MeshData> meshData;
+        if (!importModel(path, meshData))
+            return;
+        MeshCache::Write(MeshCache::CachePath(path), sourceHash, meshData);
+        for (MeshData &data : meshData)
+            meshes.push_back(Mesh(data.vertices, data.indices, loadTextures(data.textures), data.lods));
+    }
+
+    // reads a model with supported ASSIMP extensions from file into CPU side mesh data.
+    static bool importModel(string const &path, vector<MeshData> &meshData)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
@@ -67,17 +221,16 @@ private:
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, meshData);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshData)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -85,22 +238,23 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshData.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshData);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vertices.reserve(mesh->mNumVertices);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -163,58 +317,50 @@ private:
         // diffuse: texture_diffuseN
         // specular: texture_specularN
         // normal: texture_normalN
-        aiColor3D color(0.0f, 0.0f, 0.0f);
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        materialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        materialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        materialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
+        materialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
 
+        // coarser versions for the distance, cooked along with the rest
+        data.lods = MeshSimplifier::BuildLods(vertices, indices);
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the mesh data extracted from the ASSIMP mesh
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects the paths of all material textures of a given type
+    static void materialTextures(aiMaterial *mat, aiTextureType type, const string &typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory,gammaCorrection);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            TextureRef texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+    }
+
+    // acquires the referenced textures from the process-wide registry, which only loads textures it hasn't seen yet.
+    // the required info is returned as a Texture struct.
+    vector<Texture> loadTextures(const vector<TextureRef> &refs)
+    {
+        vector<Texture> textures;
+        for(const TextureRef &ref : refs)
+        {
+            Texture texture;
+            texture.id = TextureFromFile(ref.path.c_str(), this->directory,gammaCorrection);
+            texture.type = ref.type;
+            texture.path = ref.path;
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);  // every acquired reference is released again in ~Model()
         }
         return textures;
     }
@@ -226,52 +372,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gamma ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            internalFormat = gamma ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-    /*    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    */
-    //Novo
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,dataFormat==GL_RGBA? GL_CLAMP_TO_EDGE :GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, dataFormat==GL_RGBA? GL_CLAMP_TO_EDGE :GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    //end novo
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // shared between all models through the registry, decoded in the background by the TextureLoader
+    return TextureRegistry::Instance().Acquire2D(filename, gamma, true);
 }
 #endif
@@ -0,0 +1,355 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Per-pass CPU and GPU timings. Every pass is wrapped in Begin/End (or a ProfileScope); the GPU side uses
+// GL_TIME_ELAPSED queries, which can't overlap, so passes are flat and must not nest.
+// Queries rotate through QUERY_SETS sets. At the start of a frame the results of earlier frames are collected, oldest
+// first, as soon as the GL reports them available. Only when a set comes around again with its frame still unfinished,
+// the GPU then being QUERY_SETS - 1 frames behind, does the read wait for it.
+// A disabled profiler issues no GL calls at all.
+class Profiler
+{
+public:
+    // number of frames kept for the rolling history
+    static const unsigned int HISTORY = 120;
+    // frames whose queries can be in flight at once
+    static const unsigned int QUERY_SETS = 4;
+
+    struct PassStats {
+        const char *name = "";
+        unsigned int samples = 0;
+        double cpuTotal = 0.0, cpuMin = 1e30, cpuMax = 0.0;    // milliseconds
+        double gpuTotal = 0.0, gpuMin = 1e30, gpuMax = 0.0;
+        // the last HISTORY samples, a ring buffer starting at historyOffset (ImGui::PlotLines takes it as is)
+        float cpuHistory[HISTORY] = {};
+        float gpuHistory[HISTORY] = {};
+        unsigned int historyOffset = 0;
+        unsigned int historyCount = 0;
+
+        // most recent GPU time, 0 before the first recorded frame
+        float LastGpu() const
+        {
+            return historyCount == 0 ? 0.0f : gpuHistory[(historyOffset + historyCount - 1) % HISTORY];
+        }
+    };
+
+    bool Enabled = true;
+    // the first frames pay for shader compilation and driver warm-up (llvmpipe even reports a bogus time for
+    // its very first query), they are timed but not recorded
+    unsigned int WarmupFrames = 2;
+
+    Profiler()
+    {
+        frame.name = "frame";
+    }
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    ~Profiler()
+    {
+        for (FrameQueries &queries : frames)
+        {
+            if (!queries.elapsed.empty())
+                glDeleteQueries((GLsizei)queries.elapsed.size(), queries.elapsed.data());
+            if (!queries.timestamps.empty())
+                glDeleteQueries((GLsizei)queries.timestamps.size(), queries.timestamps.data());
+        }
+    }
+
+    // also records every pass as a Chrome trace event (chrome://tracing, Perfetto), see WriteChromeTrace
+    void EnableTrace()
+    {
+        tracing = true;
+        // GL_TIMESTAMP counts on the GPU clock, remember where it stands relative to the CPU clock
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuClockOffset = microseconds(Clock::now()) - gpuNow / 1000.0;
+    }
+
+    void BeginFrame()
+    {
+        if (!Enabled)
+            return;
+        // the set about to be reused holds the oldest frame, it has to be collected even if that means waiting.
+        // The newer ones are collected while their results are in, they finish in order.
+        FrameQueries &current = frames[frameNumber % QUERY_SETS];
+        collect(current);
+        for (unsigned int age = QUERY_SETS - 1; age > 0; age--)
+        {
+            FrameQueries &queries = frames[(frameNumber + QUERY_SETS - age) % QUERY_SETS];
+            if (!available(queries))
+                break;
+            collect(queries);
+        }
+        current.frameNumber = frameNumber;
+        current.cpuStart = Clock::now();
+    }
+
+    // name has to outlive the profiler (string literals)
+    void Begin(const char *name)
+    {
+        if (!Enabled)
+            return;
+        FrameQueries &current = frames[frameNumber % QUERY_SETS];
+        if (current.used == current.elapsed.size())
+        {
+            GLuint query[2];
+            glGenQueries(2, query);
+            current.elapsed.push_back(query[0]);
+            current.timestamps.push_back(query[1]);
+            current.samples.push_back(Sample());
+        }
+        Sample &sample = current.samples[current.used];
+        sample.pass = passIndex(name);
+        sample.cpuStart = Clock::now();
+        if (tracing)
+            glQueryCounter(current.timestamps[current.used], GL_TIMESTAMP);
+        glBeginQuery(GL_TIME_ELAPSED, current.elapsed[current.used]);
+        current.used++;
+    }
+
+    void End()
+    {
+        if (!Enabled)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        FrameQueries &current = frames[frameNumber % QUERY_SETS];
+        Sample &sample = current.samples[current.used - 1];
+        sample.cpuMilliseconds = milliseconds(sample.cpuStart, Clock::now());
+    }
+
+    void EndFrame()
+    {
+        if (!Enabled)
+            return;
+        FrameQueries &current = frames[frameNumber % QUERY_SETS];
+        current.cpuMilliseconds = milliseconds(current.cpuStart, Clock::now());
+        frameNumber++;
+    }
+
+    // waits for the frames still in flight and collects them, call before reading the final statistics
+    void Flush()
+    {
+        if (!Enabled)
+            return;
+        for (unsigned int age = QUERY_SETS; age > 0; age--)
+            collect(frames[(frameNumber + QUERY_SETS - age) % QUERY_SETS]);
+    }
+
+    const std::vector<PassStats>& Passes() const
+    {
+        return passes;
+    }
+
+    // CPU time from BeginFrame to EndFrame and the GPU time of all passes together
+    const PassStats& Frame() const
+    {
+        return frame;
+    }
+
+    // table of the average, minimum and maximum time of every pass over all recorded frames
+    void Report(std::ostream &out) const
+    {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-14s %8s %8s %8s   %8s %8s %8s\n", "pass [ms]", "cpu avg", "min", "max", "gpu avg", "min", "max");
+        out << line;
+        for (const PassStats &pass : passes)
+            reportLine(out, pass);
+        reportLine(out, frame);
+        if (frame.samples > 0)
+        {
+            std::snprintf(line, sizeof(line), "%u frames, %.1f fps\n", frame.samples, 1000.0 * frame.samples / frame.cpuTotal);
+            out << line;
+        }
+    }
+
+    // CPU scopes go to thread "CPU", GPU passes to thread "GPU", both on the CPU clock
+    bool WriteChromeTrace(const std::string &path) const
+    {
+        FILE *file = std::fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER:: could not write " << path << std::endl;
+            return false;
+        }
+        std::fprintf(file, "{\"traceEvents\":[\n");
+        std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+        std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+        for (const TraceEvent &event : traceEvents)
+        {
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                         passes[event.pass].name, event.gpu ? 2 : 1, event.start, event.duration, event.frameNumber);
+        }
+        std::fprintf(file, "\n]}\n");
+        std::fclose(file);
+        return true;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Sample {
+        unsigned int pass = 0;
+        Clock::time_point cpuStart;
+        double cpuMilliseconds = 0.0;
+    };
+
+    // the queries of one frame, used counts the passes issued so far
+    struct FrameQueries {
+        std::vector<GLuint> elapsed;
+        std::vector<GLuint> timestamps;
+        std::vector<Sample> samples;
+        size_t used = 0;
+        unsigned int frameNumber = 0;
+        Clock::time_point cpuStart;
+        double cpuMilliseconds = 0.0;
+    };
+
+    struct TraceEvent {
+        unsigned int pass;
+        bool gpu;
+        unsigned int frameNumber;
+        double start, duration;    // microseconds
+    };
+
+    std::vector<PassStats> passes;
+    PassStats frame;
+    FrameQueries frames[QUERY_SETS];
+    unsigned int frameNumber = 0;
+    bool tracing = false;
+    double gpuClockOffset = 0.0;
+    std::vector<TraceEvent> traceEvents;
+
+    static double milliseconds(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    static double microseconds(Clock::time_point time)
+    {
+        return std::chrono::duration<double, std::micro>(time.time_since_epoch()).count();
+    }
+
+    static void record(PassStats &pass, double cpu, double gpu)
+    {
+        pass.samples++;
+        pass.cpuTotal += cpu;
+        pass.cpuMin = std::min(pass.cpuMin, cpu);
+        pass.cpuMax = std::max(pass.cpuMax, cpu);
+        pass.gpuTotal += gpu;
+        pass.gpuMin = std::min(pass.gpuMin, gpu);
+        pass.gpuMax = std::max(pass.gpuMax, gpu);
+
+        unsigned int slot = (pass.historyOffset + pass.historyCount) % HISTORY;
+        pass.cpuHistory[slot] = (float)cpu;
+        pass.gpuHistory[slot] = (float)gpu;
+        if (pass.historyCount < HISTORY)
+            pass.historyCount++;
+        else
+            pass.historyOffset = (pass.historyOffset + 1) % HISTORY;
+    }
+
+    static void reportLine(std::ostream &out, const PassStats &pass)
+    {
+        if (pass.samples == 0)
+            return;
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-14s %8.3f %8.3f %8.3f   %8.3f %8.3f %8.3f\n", pass.name,
+                      pass.cpuTotal / pass.samples, pass.cpuMin, pass.cpuMax,
+                      pass.gpuTotal / pass.samples, pass.gpuMin, pass.gpuMax);
+        out << line;
+    }
+
+    // whether every query of a submitted frame has its result, so collect won't wait
+    bool available(const FrameQueries &queries) const
+    {
+        for (size_t i = 0; i < queries.used; i++)
+        {
+            GLuint done = GL_FALSE;
+            glGetQueryObjectuiv(queries.elapsed[i], GL_QUERY_RESULT_AVAILABLE, &done);
+            if (!done)
+                return false;
+            if (tracing)
+            {
+                glGetQueryObjectuiv(queries.timestamps[i], GL_QUERY_RESULT_AVAILABLE, &done);
+                if (!done)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // reads the results of a submitted frame into the statistics and frees its query set
+    void collect(FrameQueries &queries)
+    {
+        if (queries.used == 0)
+            return;
+        bool warmup = queries.frameNumber < WarmupFrames;
+        double gpuFrame = 0.0;
+        for (size_t i = 0; i < queries.used; i++)
+        {
+            const Sample &sample = queries.samples[i];
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries.elapsed[i], GL_QUERY_RESULT, &nanoseconds);
+            double gpuMilliseconds = nanoseconds / 1e6;
+            gpuFrame += gpuMilliseconds;
+            if (warmup)
+                continue;
+            record(passes[sample.pass], sample.cpuMilliseconds, gpuMilliseconds);
+            if (tracing)
+            {
+                GLuint64 gpuStart = 0;
+                glGetQueryObjectui64v(queries.timestamps[i], GL_QUERY_RESULT, &gpuStart);
+                traceEvents.push_back({sample.pass, false, queries.frameNumber, microseconds(sample.cpuStart), sample.cpuMilliseconds * 1000.0});
+                traceEvents.push_back({sample.pass, true, queries.frameNumber, gpuStart / 1000.0 + gpuClockOffset, gpuMilliseconds * 1000.0});
+            }
+        }
+        if (!warmup)
+            record(frame, queries.cpuMilliseconds, gpuFrame);
+        queries.used = 0;
+    }
+
+    // passes are few, a linear search keeps the frame free of allocations
+    unsigned int passIndex(const char *name)
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].name == name || std::strcmp(passes[i].name, name) == 0)
+                return i;
+        }
+        PassStats pass;
+        pass.name = name;
+        passes.push_back(pass);
+        return (unsigned int)passes.size() - 1;
+    }
+};
+
+// times the enclosing block as one pass
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler &profiler, const char *name) : profiler(profiler)
+    {
+        profiler.Begin(name);
+    }
+
+    ~ProfileScope()
+    {
+        profiler.End();
+    }
+
+private:
+    Profiler &profiler;
+};
+#endif
@@ -0,0 +1,268 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// passes in drawing order, the top bits of the sort key
+enum RenderPass {
+    PASS_OPAQUE,
+    // alpha tested (discard), mostly hidden by the opaque geometry already in the depth buffer
+    PASS_ALPHA_TESTED,
+    // blended, sorted back to front, the only pass drawn with blending on
+    PASS_TRANSPARENT,
+    // fills what nothing else covered, depth writes off and GL_LEQUAL
+    PASS_SKY
+};
+
+// one draw call and everything it needs bound. Either an instanced mesh at one of its levels of detail, whose model
+// has added instanceCount matrices starting at baseInstance to the geometry arena, or a plain draw of a vertex array
+// with one texture on unit 0 and the model matrix in a uniform.
+struct DrawPacket {
+    uint64_t key = 0;
+    Shader *shader = nullptr;
+
+    Mesh *mesh = nullptr;
+    unsigned int instanceCount = 0;
+    unsigned int baseInstance = 0;
+    unsigned int lod = 0;
+
+    unsigned int vertexArray = 0;
+    GLenum textureTarget = GL_TEXTURE_2D;
+    unsigned int texture = 0;
+    UniformHandle modelUniform;
+    glm::mat4 model = glm::mat4(1.0f);
+    GLsizei count = 0;
+    bool indexed = false;
+
+    // GL_NONE, GL_BACK or GL_FRONT
+    GLenum cullFace = GL_NONE;
+};
+
+// Collects the draws of a frame and submits them sorted by a 64-bit key: opaque draws roughly front to back, so
+// early depth testing rejects what they hide, and inside that draws sharing a program and material next to each
+// other, so the state cache can skip most of the binds between them. Blended draws go strictly back to front.
+//
+//   bits 63-60  pass
+//   opaque, alpha tested and sky: distance bucket (6 bits, front to back), program (12 bits), material (16 bits),
+//                                 depth (26 bits, front to back)
+//   transparent:                  depth (32 bits, back to front), program (12 bits), material (16 bits)
+//
+// The distance buckets grow with the distance (about 9% of it each), a strict front to back order would split
+// every run of equal materials.
+//
+// Draws with equal keys keep the order they were pushed in. Consecutive meshes with the same program, material and
+// state are drawn together with one call into the geometry arena, a single multi-draw where it is supported.
+class RenderQueue
+{
+public:
+    // empties the queue, depths are measured from viewPosition
+    void Begin(const glm::vec3 &viewPosition)
+    {
+        this->viewPosition = viewPosition;
+        packets.clear();
+        order.clear();
+        depthWritten.clear();
+        sorted = true;
+        drawCalls = 0;
+        depthDrawCalls = 0;
+    }
+
+    float Depth(const glm::vec3 &point) const
+    {
+        return glm::length(point - viewPosition);
+    }
+
+    static uint64_t MakeKey(RenderPass pass, unsigned int program, unsigned int material, float depth)
+    {
+        // the bits of a non-negative float sort like the float itself
+        uint32_t depthBits;
+        depth = std::max(depth, 0.0f);
+        std::memcpy(&depthBits, &depth, sizeof(depthBits));
+        uint64_t key = (uint64_t)pass << 60;
+        if (pass == PASS_TRANSPARENT)
+            return key | (uint64_t)(~depthBits) << 28 | (uint64_t)(program & 0xFFF) << 16 | (material & 0xFFFF);
+        uint64_t bucket = (uint64_t)std::min(std::log2(1.0f + depth) * 8.0f, 63.0f);
+        // the sign bit is 0, dropping the lowest 5 mantissa bits keeps the order
+        return key | bucket << 54 | (uint64_t)(program & 0xFFF) << 42 | (uint64_t)(material & 0xFFFF) << 26 | depthBits >> 5;
+    }
+
+    void Push(const DrawPacket &packet)
+    {
+        order.push_back({packet.key, (uint32_t)packets.size()});
+        packets.push_back(packet);
+        sorted = false;
+    }
+
+    // depth pre-pass: draws the opaque meshes that can't discard fragments into the depth buffer only, with
+    // shader, which reads the positions and the instance matrices and nothing else. Material doesn't matter
+    // there, so they merge into one draw per face culling mode. The next Submit draws these packets
+    // with GL_EQUAL and depth writes off: every pixel they cover is shaded once, by the surface that ends up
+    // visible. Leaves the same state as Submit, color writes on.
+    void SubmitDepth(Shader &shader)
+    {
+        sort();
+        GLState &state = GLState::Instance();
+        size_t end = passStart((uint64_t)PASS_OPAQUE + 1);
+        depthWritten.assign(packets.size(), 0);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        state.DepthMask(true);
+        state.DepthFunc(GL_LESS);
+        shader.use();
+        for (GLenum cullFace : {GL_NONE, GL_BACK, GL_FRONT})
+        {
+            commands.clear();
+            for (size_t i = 0; i < end; i++)
+            {
+                const DrawPacket &packet = packets[order[i].index];
+                if (!packet.mesh || packet.cullFace != cullFace || !packet.mesh->Opaque())
+                    continue;
+                depthWritten[order[i].index] = 1;
+                commands.push_back(packet.mesh->DrawCommand(packet.instanceCount, packet.baseInstance, packet.lod));
+            }
+            if (commands.empty())
+                continue;
+            state.SetEnabled(GL_CULL_FACE, cullFace != GL_NONE);
+            if (cullFace != GL_NONE)
+                state.CullFace(cullFace);
+            depthDrawCalls += GeometryArena::Instance().Draw(commands.data(), commands.size(), true);
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        state.SetEnabled(GL_CULL_FACE, false);
+        state.BindVertexArray(0);
+    }
+
+    // sorts and draws the packets of the passes first to last, so other work can go between passes (the deferred
+    // lighting after the opaque pass). Every packet sets the blend, depth and cull state of its pass through the
+    // state cache, which only forwards the transitions. Leaves blending and face culling off, depth writes on and
+    // GL_LESS, with texture unit 0 active and no vertex array bound.
+    void Submit(RenderPass first = PASS_OPAQUE, RenderPass last = PASS_SKY)
+    {
+        sort();
+        GLState &state = GLState::Instance();
+        size_t begin = passStart(first);
+        size_t end = passStart((uint64_t)last + 1);
+        for (size_t i = begin; i < end; i++)
+        {
+            DrawPacket &packet = packets[order[i].index];
+            // the sky is drawn at the far plane, where the cleared depth buffer equals it
+            bool sky = (packet.key >> 60) == PASS_SKY;
+            bool equal = prepassed(i);
+            state.SetEnabled(GL_BLEND, (packet.key >> 60) == PASS_TRANSPARENT);
+            state.DepthMask(!sky && !equal);
+            state.DepthFunc(sky ? GL_LEQUAL : equal ? GL_EQUAL : GL_LESS);
+            state.SetEnabled(GL_CULL_FACE, packet.cullFace != GL_NONE);
+            if (packet.cullFace != GL_NONE)
+                state.CullFace(packet.cullFace);
+
+            packet.shader->use();
+            if (packet.mesh)
+            {
+                packet.mesh->BindMaterial(*packet.shader);
+                commands.clear();
+                commands.push_back(packet.mesh->DrawCommand(packet.instanceCount, packet.baseInstance, packet.lod));
+                while (i + 1 < end && batches(packet, packets[order[i + 1].index]) && prepassed(i + 1) == equal)
+                {
+                    const DrawPacket &next = packets[order[++i].index];
+                    commands.push_back(next.mesh->DrawCommand(next.instanceCount, next.baseInstance, next.lod));
+                }
+                drawCalls += GeometryArena::Instance().Draw(commands.data(), commands.size());
+                continue;
+            }
+            state.BindTexture(0, packet.textureTarget, packet.texture);
+            if (packet.modelUniform.Valid())
+                packet.shader->setMat4(packet.modelUniform, packet.model);
+            state.BindVertexArray(packet.vertexArray);
+            if (packet.indexed)
+                glDrawElements(GL_TRIANGLES, packet.count, GL_UNSIGNED_INT, nullptr);
+            else
+                glDrawArrays(GL_TRIANGLES, 0, packet.count);
+            drawCalls++;
+        }
+
+        state.SetEnabled(GL_BLEND, false);
+        state.SetEnabled(GL_CULL_FACE, false);
+        state.DepthMask(true);
+        state.DepthFunc(GL_LESS);
+        state.ActiveTexture(0);
+        state.BindVertexArray(0);
+    }
+
+    size_t Size() const
+    {
+        return packets.size();
+    }
+
+    // draw calls the Submits since Begin issued for their packets
+    unsigned int DrawCalls() const
+    {
+        return drawCalls;
+    }
+
+    // draw calls of the depth pre-pass since Begin
+    unsigned int DepthDrawCalls() const
+    {
+        return depthDrawCalls;
+    }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    void sort()
+    {
+        if (sorted)
+            return;
+        std::sort(order.begin(), order.end(), [](const SortEntry &a, const SortEntry &b) {
+            return a.key != b.key ? a.key < b.key : a.index < b.index;
+        });
+        sorted = true;
+    }
+
+    // whether the depth pre-pass drew the sorted packet at position i
+    bool prepassed(size_t i) const
+    {
+        return !depthWritten.empty() && depthWritten[order[i].index];
+    }
+
+    // index of the first sorted packet whose pass is at least pass
+    size_t passStart(uint64_t pass) const
+    {
+        SortEntry bound = {pass << 60, 0};
+        return std::lower_bound(order.begin(), order.end(), bound, [](const SortEntry &a, const SortEntry &b) {
+            return a.key < b.key;
+        }) - order.begin();
+    }
+
+    // whether next can be drawn in the same call as packet
+    static bool batches(const DrawPacket &packet, const DrawPacket &next)
+    {
+        return next.mesh && next.shader == packet.shader && next.cullFace == packet.cullFace &&
+               (next.key >> 60) == (packet.key >> 60) && next.mesh->SameMaterial(*packet.mesh);
+    }
+
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+    std::vector<DrawPacket> packets;
+    std::vector<SortEntry> order;
+    std::vector<DrawElementsIndirectCommand> commands;
+    // per packet whether the depth pre-pass wrote its depth, empty without one
+    std::vector<uint8_t> depthWritten;
+    unsigned int drawCalls = 0;
+    unsigned int depthDrawCalls = 0;
+    bool sorted = true;
+};
+#endif
@@ -0,0 +1,254 @@
+#ifndef RENDER_TARGETS_H
+#define RENDER_TARGETS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// bytes per pixel of the HDR color formats the render targets can use
+inline unsigned int ColorFormatBytes(GLenum format)
+{
+    switch (format)
+    {
+        case GL_RGBA16F: return 8;
+        case GL_R11F_G11F_B10F: return 4;
+        case GL_RGBA32F: return 16;
+        default: return 4;
+    }
+}
+
+// Offscreen targets of the post-process chain: the HDR scene framebuffer (scene color, bright color and depth)
+// and the two ping-pong blur framebuffers, plus the G-buffer of the deferred renderer when it is asked for.
+// Their size follows the window times the render scale, the blur targets can be smaller by the bloom divisor.
+// The color format is either GL_RGBA16F or the packed GL_R11F_G11F_B10F (no alpha, which none of the targets
+// needs, at half the bytes). Resize keeps the object names and only reallocates the storage, so framebuffer
+// attachments stay valid.
+class RenderTargets
+{
+public:
+    unsigned int HdrFramebuffer = 0;
+    // 0: scene color, 1: bright color for the bloom
+    unsigned int ColorBuffers[2] = {0, 0};
+    unsigned int PingpongFramebuffers[2] = {0, 0};
+    unsigned int PingpongColorbuffers[2] = {0, 0};
+    // deferred shading, shares the depth buffer of the HDR framebuffer.
+    // 0: albedo (RGBA8), 1: specular color (RGBA8), 2: world normal and view depth (RGBA32F, depth 0 where empty)
+    unsigned int GBufferFramebuffer = 0;
+    unsigned int GBuffers[3] = {0, 0, 0};
+    // the bright color alone, for the pass that extracts it from the lit scene color
+    unsigned int BrightFramebuffer = 0;
+
+    RenderTargets()
+    {
+        glGenFramebuffers(1, &HdrFramebuffer);
+        glGenTextures(2, ColorBuffers);
+        glGenRenderbuffers(1, &depthRenderbuffer);
+        glGenFramebuffers(2, PingpongFramebuffers);
+        glGenTextures(2, PingpongColorbuffers);
+        glGenFramebuffers(1, &GBufferFramebuffer);
+        glGenTextures(3, GBuffers);
+        glGenFramebuffers(1, &BrightFramebuffer);
+    }
+
+    RenderTargets(const RenderTargets&) = delete;
+    RenderTargets& operator=(const RenderTargets&) = delete;
+
+    ~RenderTargets()
+    {
+        glDeleteFramebuffers(1, &HdrFramebuffer);
+        glDeleteTextures(2, ColorBuffers);
+        glDeleteRenderbuffers(1, &depthRenderbuffer);
+        glDeleteFramebuffers(2, PingpongFramebuffers);
+        glDeleteTextures(2, PingpongColorbuffers);
+        glDeleteFramebuffers(1, &GBufferFramebuffer);
+        glDeleteTextures(3, GBuffers);
+        glDeleteFramebuffers(1, &BrightFramebuffer);
+    }
+
+    // (re)allocates the scene targets at width x height and the blur targets at 1 / bloomDivisor of that, the
+    // G-buffer only while withGBuffer is set (it shrinks to nothing otherwise). Does nothing when none of it changed.
+    // Leaves framebuffer 0 bound.
+    void Resize(unsigned int newWidth, unsigned int newHeight, GLenum newFormat = GL_RGBA16F, unsigned int newBloomDivisor = 1,
+                bool withGBuffer = false)
+    {
+        newWidth = std::max(newWidth, 1u);
+        newHeight = std::max(newHeight, 1u);
+        newBloomDivisor = std::max(newBloomDivisor, 1u);
+        if (newWidth == width && newHeight == height && newFormat == format && newBloomDivisor == bloomDivisor &&
+            withGBuffer == gbuffer)
+            return;
+        bool attach = width == 0;
+        width = newWidth;
+        height = newHeight;
+        format = newFormat;
+        bloomDivisor = newBloomDivisor;
+        gbuffer = withGBuffer;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, HdrFramebuffer);
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            allocateColor(ColorBuffers[i], width, height);
+            if (attach)
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, ColorBuffers[i], 0);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        if (attach)
+        {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+            // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
+            unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+            glDrawBuffers(2, attachments);
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_TARGETS:: HDR framebuffer not complete!" << std::endl;
+
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, PingpongFramebuffers[i]);
+            allocateColor(PingpongColorbuffers[i], BloomWidth(), BloomHeight());
+            if (attach)
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, PingpongColorbuffers[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::RENDER_TARGETS:: ping-pong framebuffer not complete!" << std::endl;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, GBufferFramebuffer);
+        const GLenum gbufferFormats[3] = {GL_RGBA8, GL_RGBA8, GL_RGBA32F};
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, GBuffers[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, gbufferFormats[i], gbuffer ? width : 1, gbuffer ? height : 1, 0, GL_RGBA,
+                         i == 2 ? GL_FLOAT : GL_UNSIGNED_BYTE, NULL);
+            // read with texelFetch, one texel per pixel
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            if (attach)
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, GBuffers[i], 0);
+        }
+        if (attach)
+        {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+            unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+            glDrawBuffers(3, attachments);
+        }
+        if (gbuffer && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_TARGETS:: G-buffer not complete!" << std::endl;
+
+        if (attach)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, BrightFramebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ColorBuffers[1], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::RENDER_TARGETS:: bright framebuffer not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    unsigned int Width() const
+    {
+        return width;
+    }
+
+    unsigned int Height() const
+    {
+        return height;
+    }
+
+    // size of the ping-pong blur targets
+    unsigned int BloomWidth() const
+    {
+        return std::max(width / bloomDivisor, 1u);
+    }
+
+    unsigned int BloomHeight() const
+    {
+        return std::max(height / bloomDivisor, 1u);
+    }
+
+    GLenum Format() const
+    {
+        return format;
+    }
+
+    bool HasGBuffer() const
+    {
+        return gbuffer;
+    }
+
+    // video memory taken by all targets, the 24 bit depth buffer counted as 4 bytes per pixel
+    size_t MemoryBytes() const
+    {
+        size_t scenePixels = (size_t)width * height;
+        size_t bloomPixels = (size_t)BloomWidth() * BloomHeight();
+        size_t gbufferBytes = gbuffer ? scenePixels * (4 + 4 + 16) : 0;
+        return (2 * scenePixels + 2 * bloomPixels) * ColorFormatBytes(format) + scenePixels * 4 + gbufferBytes;
+    }
+
+private:
+    unsigned int depthRenderbuffer = 0;
+    unsigned int width = 0, height = 0;
+    GLenum format = GL_RGBA16F;
+    unsigned int bloomDivisor = 1;
+    bool gbuffer = false;
+
+    void allocateColor(unsigned int texture, unsigned int textureWidth, unsigned int textureHeight)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, textureWidth, textureHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+};
+
+// Chooses the render scale from the measured GPU frame time. Over budget the scale drops to what should fit
+// (cost goes with the pixel count, the square of the scale), well under budget it climbs back one step at a time.
+// Every change reallocates the render targets, so the scale moves in steps and waits a few frames in between.
+class DynamicResolution
+{
+public:
+    bool Enabled = false;
+    float BudgetMilliseconds = 16.6f;
+    float MinScale = 0.5f;
+    float MaxScale = 1.0f;
+    float Scale = 1.0f;
+
+    // feeds the GPU time of the last finished frame, returns true when Scale changed
+    bool Update(float gpuMilliseconds)
+    {
+        if (!Enabled || gpuMilliseconds <= 0.0f)
+            return false;
+        average = average == 0.0f ? gpuMilliseconds : 0.9f * average + 0.1f * gpuMilliseconds;
+        if (++framesSinceChange < SETTLE_FRAMES)
+            return false;
+
+        float scale = Scale;
+        if (average > BudgetMilliseconds)
+            scale = std::min(std::floor(Scale * std::sqrt(BudgetMilliseconds / average) / STEP + 0.01f) * STEP, Scale - STEP);
+        else if (average < HEADROOM * BudgetMilliseconds)
+            scale = Scale + STEP;
+        scale = std::min(std::max(scale, MinScale), MaxScale);
+        if (std::fabs(scale - Scale) < 0.001f)
+            return false;
+        Scale = scale;
+        // measure the new scale from scratch
+        average = 0.0f;
+        framesSinceChange = 0;
+        return true;
+    }
+
+private:
+    static constexpr float STEP = 0.05f;
+    // scale up only while the frame takes less than this part of the budget
+    static constexpr float HEADROOM = 0.75f;
+    static const unsigned int SETTLE_FRAMES = 30;
+
+    float average = 0.0f;
+    unsigned int framesSinceChange = 0;
+};
+#endif
@@ -0,0 +1,173 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/lod.h>
+#include <learnopengl/model.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/shader.h>
+
+#include <cstdint>
+#include <vector>
+
+// Placed objects in structure-of-arrays form: every component of an entity sits at the entity's index in its own
+// array. World matrices are cached and only recomputed for entities whose transform changed since the last
+// UpdateTransforms, so static objects cost nothing per frame. Entities with a model are grouped per model into a
+// contiguous array of world matrices that Model::Queue takes as it is; entities without one (the quads
+// drawn by hand) only provide their world matrix.
+class Scene
+{
+public:
+    typedef unsigned int Entity;
+
+    // model can be null, it has to outlive the scene otherwise
+    Entity Add(Model *model, const glm::vec3 &position, const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+               const glm::vec3 &scale = glm::vec3(1.0f))
+    {
+        Entity entity = (Entity)positions.size();
+        positions.push_back(position);
+        rotations.push_back(rotation);
+        scales.push_back(scale);
+        worldMatrices.push_back(glm::mat4(1.0f));
+        dirty.push_back(0);
+        batchOf.push_back(0);
+        batchSlots.push_back(0);
+        if (model)
+        {
+            unsigned int batch = batchIndex(model);
+            batchOf[entity] = batch;
+            batchSlots[entity] = (unsigned int)batches[batch].transforms.size();
+            batches[batch].transforms.push_back(glm::mat4(1.0f));
+            batches[batch].lodLevels.push_back(0);
+        }
+        else
+            batchOf[entity] = NO_BATCH;
+        markDirty(entity);
+        return entity;
+    }
+
+    // removes all entities, the next Add starts at entity 0 again
+    void Clear()
+    {
+        positions.clear();
+        rotations.clear();
+        scales.clear();
+        worldMatrices.clear();
+        dirty.clear();
+        batchOf.clear();
+        batchSlots.clear();
+        dirtyEntities.clear();
+        batches.clear();
+    }
+
+    void SetPosition(Entity entity, const glm::vec3 &position)
+    {
+        positions[entity] = position;
+        markDirty(entity);
+    }
+
+    void SetRotation(Entity entity, const glm::quat &rotation)
+    {
+        rotations[entity] = rotation;
+        markDirty(entity);
+    }
+
+    void SetScale(Entity entity, const glm::vec3 &scale)
+    {
+        scales[entity] = scale;
+        markDirty(entity);
+    }
+
+    // recomputes the world matrices of the entities changed since the last call, once per frame before drawing
+    void UpdateTransforms()
+    {
+        for (Entity entity : dirtyEntities)
+        {
+            glm::mat4 &world = worldMatrices[entity];
+            world = glm::translate(glm::mat4(1.0f), positions[entity]) * glm::mat4_cast(rotations[entity]);
+            world = glm::scale(world, scales[entity]);
+            dirty[entity] = 0;
+            if (batchOf[entity] != NO_BATCH)
+                batches[batchOf[entity]].transforms[batchSlots[entity]] = world;
+        }
+        lastUpdated = (unsigned int)dirtyEntities.size();
+        dirtyEntities.clear();
+    }
+
+    // queues every placement of the model inside the frustum, one instanced draw per mesh and level of detail
+    void Queue(Model &model, RenderQueue &queue, Shader &shader, const Frustum &frustum, LodSelector &lods, CullStats &stats)
+    {
+        for (Batch &batch : batches)
+        {
+            if (batch.model == &model)
+                batch.model->Queue(queue, shader, batch.transforms.data(), batch.transforms.size(), frustum, lods,
+                                   batch.lodLevels.data(), stats);
+        }
+    }
+
+    const glm::mat4& WorldMatrix(Entity entity) const
+    {
+        return worldMatrices[entity];
+    }
+
+    size_t Size() const
+    {
+        return positions.size();
+    }
+
+    // world matrices recomputed by the last UpdateTransforms
+    unsigned int LastUpdated() const
+    {
+        return lastUpdated;
+    }
+
+private:
+    static const unsigned int NO_BATCH = ~0u;
+
+    // world matrices of all placements of one model, in the order they were added, and the level of detail each
+    // was drawn with last frame
+    struct Batch {
+        Model *model;
+        std::vector<glm::mat4> transforms;
+        std::vector<uint8_t> lodLevels;
+    };
+
+    // components, indexed by entity
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<uint8_t> dirty;
+    // batch of the entity's model and its slot in the batch
+    std::vector<unsigned int> batchOf;
+    std::vector<unsigned int> batchSlots;
+
+    std::vector<Entity> dirtyEntities;
+    std::vector<Batch> batches;
+    unsigned int lastUpdated = 0;
+
+    void markDirty(Entity entity)
+    {
+        if (dirty[entity])
+            return;
+        dirty[entity] = 1;
+        dirtyEntities.push_back(entity);
+    }
+
+    // models are few, a linear search is enough
+    unsigned int batchIndex(Model *model)
+    {
+        for (unsigned int i = 0; i < batches.size(); i++)
+        {
+            if (batches[i].model == model)
+                return i;
+        }
+        batches.push_back({model, {}, {}});
+        return (unsigned int)batches.size() - 1;
+    }
+};
+#endif
@@ -0,0 +1,427 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Scene description: which models to load, where their instances go and where the lights are. It is authored as
+// text, one entry per line ('#' starts a comment):
+//
+//   model    <name> <path> [floating]    a model to load, the instances of a floating one bob up and down
+//   quad     <name> plant|portal|water   one of the quads the renderer draws itself
+//   instance <name> x y z [yaw [scale]]  a placement of a model, yaw in degrees around the y axis, uniform scale
+//   light    x y z                       a point light
+//   candle   x y z                       a candle light
+//
+// Every value has to be there and be well formed, only the optional ones may be left off at the end of the line.
+// The text is cooked into a binary form next to it (<scene>.rgscene), in host byte order:
+//
+//   header : "RGSC", version, model count, instance count, light count, candle count, then as 64-bit values the
+//            size, modification time and hash of the text
+//   models : name and path length, role, then name and path, padded to 4 bytes
+//   then the SceneInstance array, the light positions and the candle positions
+//
+// The cooked file is taken as it is while the text has the recorded size and modification time, the text is only
+// hashed when one of them differs. Bump SCENE_CACHE_VERSION whenever the layout changes, the old files are then
+// treated as misses and rebuilt.
+const uint32_t SCENE_CACHE_VERSION = 2;
+
+// what the renderer does with the instances of a model beyond drawing it
+enum SceneRole {
+    ROLE_NONE,
+    ROLE_FLOATING,
+    // the quads, the model has no path
+    ROLE_PLANT,
+    ROLE_PORTAL,
+    ROLE_WATER
+};
+
+struct SceneModel {
+    std::string name;
+    std::string path;
+    SceneRole role = ROLE_NONE;
+};
+
+struct SceneInstance {
+    uint32_t model;    // index into SceneDescription::models
+    glm::vec3 position;
+    float yaw;         // degrees
+    float scale;
+};
+
+static_assert(std::is_trivially_copyable<SceneInstance>::value && sizeof(SceneInstance) == 24,
+              "SceneInstance is written to the scene cache byte by byte");
+
+class SceneDescription
+{
+public:
+    std::vector<SceneModel> models;
+    std::vector<SceneInstance> instances;
+    std::vector<glm::vec3> lights;
+    std::vector<glm::vec3> candles;
+    // whether the last Load read the cooked file
+    bool cooked = false;
+
+    static std::string CachePath(const std::string &path)
+    {
+        return path + ".rgscene";
+    }
+
+    // what the cooked file records about the text. The size and modification time decide whether it can be taken
+    // without hashing the text, the hash is only computed (hashed) when they differ.
+    struct SourceStamp {
+        uint64_t size = 0;
+        int64_t modified = 0;
+        uint64_t hash = 0;
+        bool hashed = false;
+    };
+
+    static SourceStamp Stamp(const std::string &path)
+    {
+        SourceStamp stamp;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0)
+        {
+            stamp.size = (uint64_t)st.st_size;
+            stamp.modified = (int64_t)st.st_mtime;
+        }
+        return stamp;
+    }
+
+    static uint64_t SourceHash(const std::string &path)
+    {
+        uint64_t hash = HashBytes(&SCENE_CACHE_VERSION, sizeof(SCENE_CACHE_VERSION));
+        MappedFile source;
+        if (source.Open(path))
+            hash = HashBytes(source.Data(), source.Size(), hash);
+        return hash;
+    }
+
+    // modification time of the text, 0 if it doesn't exist. Used to notice edits for hot reloading.
+    static time_t ModifiedTime(const std::string &path)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return 0;
+        return st.st_mtime;
+    }
+
+    // reads the cooked form if it is up to date, otherwise parses the text and cooks it.
+    // On failure the description is left as it was.
+    bool Load(const std::string &path)
+    {
+        SourceStamp source = Stamp(path);
+        SceneDescription loaded;
+        if (loaded.readCooked(path, source))
+        {
+            loaded.cooked = true;
+            // the text was touched but not changed, record the new stamp so the next load doesn't hash it again
+            if (source.hashed)
+                loaded.WriteCooked(CachePath(path), source);
+        }
+        else
+        {
+            if (!loaded.parse(path))
+                return false;
+            hashSource(path, source);
+            loaded.WriteCooked(CachePath(path), source);
+        }
+        *this = std::move(loaded);
+        return true;
+    }
+
+    // parses the text and writes the cooked form, unless it is already up to date. Does not touch OpenGL.
+    static bool Cook(const std::string &path, bool force = false)
+    {
+        SourceStamp source = Stamp(path);
+        SceneDescription description;
+        if (!force && description.readCooked(path, source))
+            return !source.hashed || description.WriteCooked(CachePath(path), source);
+        if (!description.parse(path))
+            return false;
+        hashSource(path, source);
+        return description.WriteCooked(CachePath(path), source);
+    }
+
+    bool WriteCooked(const std::string &cachePath, const SourceStamp &source) const
+    {
+        // write to a temporary file first so an interrupted cook never leaves a truncated file behind
+        std::string tempPath = cachePath + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::SCENE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        out.write(MAGIC, 4);
+        writeU32(out, SCENE_CACHE_VERSION);
+        writeU32(out, (uint32_t)models.size());
+        writeU32(out, (uint32_t)instances.size());
+        writeU32(out, (uint32_t)lights.size());
+        writeU32(out, (uint32_t)candles.size());
+        out.write(reinterpret_cast<const char*>(&source.size), sizeof(source.size));
+        out.write(reinterpret_cast<const char*>(&source.modified), sizeof(source.modified));
+        out.write(reinterpret_cast<const char*>(&source.hash), sizeof(source.hash));
+        for (const SceneModel &model : models)
+        {
+            writeU32(out, (uint32_t)model.name.size());
+            writeU32(out, (uint32_t)model.path.size());
+            writeU32(out, model.role);
+            out.write(model.name.data(), model.name.size());
+            out.write(model.path.data(), model.path.size());
+            static const char padding[4] = {0, 0, 0, 0};
+            out.write(padding, (4 - (model.name.size() + model.path.size()) % 4) % 4);
+        }
+        out.write(reinterpret_cast<const char*>(instances.data()), instances.size() * sizeof(SceneInstance));
+        out.write(reinterpret_cast<const char*>(lights.data()), lights.size() * sizeof(glm::vec3));
+        out.write(reinterpret_cast<const char*>(candles.data()), candles.size() * sizeof(glm::vec3));
+        out.close();
+        if (!out || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+            std::cout << "ERROR::SCENE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // index of the model with this name, -1 if there is none
+    int FindModel(const std::string &name) const
+    {
+        for (unsigned int i = 0; i < models.size(); i++)
+        {
+            if (models[i].name == name)
+                return (int)i;
+        }
+        return -1;
+    }
+
+private:
+    static constexpr const char *MAGIC = "RGSC";
+
+    bool parse(const std::string &path)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            std::cout << "ERROR::SCENE:: could not read " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        unsigned int lineNumber = 0;
+        while (std::getline(in, line))
+        {
+            lineNumber++;
+            size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+            std::istringstream fields(line);
+            std::string keyword;
+            if (!(fields >> keyword))
+                continue;
+
+            bool valid = true;
+            if (keyword == "model" || keyword == "quad")
+            {
+                SceneModel model;
+                std::string option;
+                if (keyword == "model")
+                {
+                    valid = (bool)(fields >> model.name >> model.path);
+                    if (valid && !atEnd(fields))
+                    {
+                        fields >> option;
+                        if (option != "floating")
+                            return parseError(path, lineNumber, "unknown model option " + option);
+                        model.role = ROLE_FLOATING;
+                    }
+                }
+                else
+                {
+                    valid = (bool)(fields >> model.name >> option);
+                    if (option == "plant")
+                        model.role = ROLE_PLANT;
+                    else if (option == "portal")
+                        model.role = ROLE_PORTAL;
+                    else if (option == "water")
+                        model.role = ROLE_WATER;
+                    else if (valid)
+                        return parseError(path, lineNumber, "unknown quad kind " + option);
+                }
+                if (valid && FindModel(model.name) >= 0)
+                    return parseError(path, lineNumber, "model " + model.name + " declared twice");
+                models.push_back(model);
+            }
+            else if (keyword == "instance")
+            {
+                std::string name;
+                SceneInstance instance;
+                valid = (bool)(fields >> name >> instance.position.x >> instance.position.y >> instance.position.z);
+                int model = FindModel(name);
+                if (valid && model < 0)
+                    return parseError(path, lineNumber, "unknown model " + name);
+                instance.model = (uint32_t)model;
+                instance.yaw = 0.0f;
+                instance.scale = 1.0f;
+                if (valid && !atEnd(fields))
+                    valid = (bool)(fields >> instance.yaw);
+                if (valid && !atEnd(fields))
+                    valid = (bool)(fields >> instance.scale);
+                instances.push_back(instance);
+            }
+            else if (keyword == "light" || keyword == "candle")
+            {
+                glm::vec3 position;
+                valid = (bool)(fields >> position.x >> position.y >> position.z);
+                (keyword == "light" ? lights : candles).push_back(position);
+            }
+            else
+            {
+                return parseError(path, lineNumber, "unknown keyword " + keyword);
+            }
+            if (!valid)
+                return parseError(path, lineNumber, "missing or malformed values for " + keyword);
+            if (!atEnd(fields))
+                return parseError(path, lineNumber, "unexpected values after " + keyword);
+        }
+        return true;
+    }
+
+    // whether only whitespace is left on the line
+    static bool atEnd(std::istringstream &fields)
+    {
+        fields >> std::ws;
+        return fields.eof();
+    }
+
+    static bool parseError(const std::string &path, unsigned int lineNumber, const std::string &message)
+    {
+        std::cout << "ERROR::SCENE:: " << path << ":" << lineNumber << ": " << message << std::endl;
+        return false;
+    }
+
+    static void hashSource(const std::string &path, SourceStamp &source)
+    {
+        if (source.hashed)
+            return;
+        source.hash = SourceHash(path);
+        source.hashed = true;
+    }
+
+    // validates the cooked file against the text at path: the size and modification time first, the hash only if
+    // they differ (it is then left in source). Returns false on any mismatch.
+    bool readCooked(const std::string &path, SourceStamp &source)
+    {
+        fail();
+        MappedFile file;
+        if (!file.Open(CachePath(path)))
+            return false;
+        const unsigned char *cursor = file.Data();
+        const unsigned char *end = file.Data() + file.Size();
+
+        uint32_t version, modelCount, instanceCount, lightCount, candleCount;
+        SourceStamp cookedStamp;
+        if (!has(cursor, end, 4) || std::memcmp(cursor, MAGIC, 4) != 0)
+            return fail();
+        cursor += 4;
+        if (!readU32(cursor, end, version) || !readU32(cursor, end, modelCount) || !readU32(cursor, end, instanceCount) ||
+            !readU32(cursor, end, lightCount) || !readU32(cursor, end, candleCount) ||
+            !has(cursor, end, sizeof(cookedStamp.size) + sizeof(cookedStamp.modified) + sizeof(cookedStamp.hash)))
+            return fail();
+        std::memcpy(&cookedStamp.size, cursor, sizeof(cookedStamp.size));
+        cursor += sizeof(cookedStamp.size);
+        std::memcpy(&cookedStamp.modified, cursor, sizeof(cookedStamp.modified));
+        cursor += sizeof(cookedStamp.modified);
+        std::memcpy(&cookedStamp.hash, cursor, sizeof(cookedStamp.hash));
+        cursor += sizeof(cookedStamp.hash);
+        if (version != SCENE_CACHE_VERSION)
+            return fail();
+        if (cookedStamp.size != source.size || cookedStamp.modified != source.modified)
+        {
+            hashSource(path, source);
+            if (source.hash != cookedStamp.hash)
+                return fail();
+        }
+
+        for (uint32_t i = 0; i < modelCount; i++)
+        {
+            uint32_t nameLength, pathLength, role;
+            if (!readU32(cursor, end, nameLength) || !readU32(cursor, end, pathLength) || !readU32(cursor, end, role) ||
+                role > ROLE_WATER)
+                return fail();
+            size_t padded = nameLength + pathLength;
+            padded += (4 - padded % 4) % 4;
+            if (!has(cursor, end, padded))
+                return fail();
+            SceneModel model;
+            model.name.assign(reinterpret_cast<const char*>(cursor), nameLength);
+            model.path.assign(reinterpret_cast<const char*>(cursor) + nameLength, pathLength);
+            model.role = (SceneRole)role;
+            models.push_back(model);
+            cursor += padded;
+        }
+        size_t instanceBytes = (size_t)instanceCount * sizeof(SceneInstance);
+        size_t lightBytes = (size_t)(lightCount + candleCount) * sizeof(glm::vec3);
+        if (!has(cursor, end, instanceBytes + lightBytes))
+            return fail();
+        instances.resize(instanceCount);
+        std::memcpy(instances.data(), cursor, instanceBytes);
+        cursor += instanceBytes;
+        lights.resize(lightCount);
+        std::memcpy(lights.data(), cursor, lightCount * sizeof(glm::vec3));
+        cursor += lightCount * sizeof(glm::vec3);
+        candles.resize(candleCount);
+        std::memcpy(candles.data(), cursor, candleCount * sizeof(glm::vec3));
+        for (const SceneInstance &instance : instances)
+        {
+            if (instance.model >= modelCount)
+                return fail();
+        }
+        return true;
+    }
+
+    bool fail()
+    {
+        models.clear();
+        instances.clear();
+        lights.clear();
+        candles.clear();
+        return false;
+    }
+
+    static bool has(const unsigned char *cursor, const unsigned char *end, size_t bytes)
+    {
+        return (size_t)(end - cursor) >= bytes;
+    }
+
+    static bool readU32(const unsigned char *&cursor, const unsigned char *end, uint32_t &value)
+    {
+        if (!has(cursor, end, sizeof(value)))
+            return false;
+        std::memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return true;
+    }
+
+    static void writeU32(std::ofstream &out, uint32_t value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+};
+#endif
@@ -0,0 +1,373 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/dds.h>
+#include <learnopengl/mapped_file.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Decodes image files on a pool of worker threads. The GL texture name is created and returned right away
+// (with a 1x1 transparent placeholder), the decoded pixels are uploaded later on the main thread by Update().
+// Cooked .dds files are recognized by their header and uploaded as they are, mip chain included.
+// stbi_set_flip_vertically_on_load() must be called before the first request, the workers only read that flag.
+class TextureLoader
+{
+public:
+    static TextureLoader& Instance()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    // clampAlpha: textures with transparent texels get GL_CLAMP_TO_EDGE instead of GL_REPEAT (cutout sprites, leaves)
+    // source: the already mapped file contents, if the caller has them; otherwise the worker reads the file itself
+    unsigned int Load2D(const std::string &path, bool gamma, bool clampAlpha, std::shared_ptr<MappedFile> source = nullptr)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // the name may be one a released texture had
+        opaqueTextures.erase(textureID);
+
+        Job *job = new Job();
+        job->textureID = textureID;
+        job->generation = generations[textureID] = ++lastGeneration;
+        job->target = GL_TEXTURE_2D;
+        job->path = path;
+        job->gamma = gamma;
+        job->clampAlpha = clampAlpha;
+        job->source = source;
+        submit(job);
+        return textureID;
+    }
+
+    // cube map faces in the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order, always uploaded as sRGB
+    unsigned int LoadCubeMap(const std::vector<std::string> &faces, const std::vector<std::shared_ptr<MappedFile>> &sources = {})
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        for (unsigned int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        unsigned int generation = generations[textureID] = ++lastGeneration;
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            Job *job = new Job();
+            job->textureID = textureID;
+            job->generation = generation;
+            job->target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            job->path = faces[i];
+            job->gamma = true;
+            if (i < sources.size())
+                job->source = sources[i];
+            submit(job);
+        }
+        return textureID;
+    }
+
+    // forgets the texture's pending uploads, call before deleting it: GL may hand its name to the next new texture,
+    // which must not receive the old image. Main thread only.
+    void Cancel(unsigned int textureID)
+    {
+        generations.erase(textureID);
+        opaqueTextures.erase(textureID);
+        // what no worker has started yet isn't decoded at all
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.erase(std::remove_if(queued.begin(), queued.end(), [textureID](Job *job) {
+            if (job->textureID != textureID)
+                return false;
+            delete job;
+            return true;
+        }), queued.end());
+    }
+
+    // uploads every texture that finished decoding since the last call. Main thread only.
+    void Update()
+    {
+        std::vector<Job*> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.swap(decoded);
+        }
+        for (Job *job : finished)
+        {
+            upload(*job);
+            delete job;
+        }
+    }
+
+    // blocks until all requested textures are decoded and uploaded
+    void Finish()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finishedCondition.wait(lock, [this] { return queued.empty() && running == 0; });
+        }
+        Update();
+    }
+
+    // whether the 2D texture is uploaded and has no transparent texel, so nothing drawn with it is ever discarded.
+    // False while it is still loading. Main thread only.
+    bool IsOpaque(unsigned int texture) const
+    {
+        return opaqueTextures.count(texture) != 0;
+    }
+
+    // number of textures still waiting for decode or upload
+    size_t Pending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queued.size() + running + decoded.size();
+    }
+
+    // stops the workers and drops everything not uploaded yet; call before the GL context goes away
+    void Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobCondition.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        workers.clear();
+        for (Job *job : queued)
+            delete job;
+        for (Job *job : decoded)
+        {
+            stbi_image_free(job->data);
+            delete job;
+        }
+        queued.clear();
+        decoded.clear();
+    }
+
+    ~TextureLoader()
+    {
+        Shutdown();
+    }
+
+private:
+    struct Job {
+        unsigned int textureID = 0;
+        // the load the job belongs to, stale once the texture was cancelled
+        unsigned int generation = 0;
+        GLenum target = GL_TEXTURE_2D;
+        std::string path;
+        bool gamma = false;
+        bool clampAlpha = false;
+        std::shared_ptr<MappedFile> source;
+        // filled in by the worker
+        unsigned char *data = nullptr;
+        int width = 0, height = 0, nrComponents = 0;
+        // some alpha below 1, the same test the asset cooker picks BC3 over BC1 with, so a cooked file is transparent
+        // when it is BC3. Decides the wrap mode and the depth pre-pass either way.
+        bool transparent = false;
+        bool compressed = false;
+        DdsImage dds;       // points into source, which is then kept alive until the upload
+    };
+
+    static constexpr unsigned char PLACEHOLDER[4] = {0, 0, 0, 0};
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobCondition;
+    std::condition_variable finishedCondition;
+    std::deque<Job*> queued;
+    std::vector<Job*> decoded;
+    unsigned int running = 0;
+    bool stopping = false;
+    // uploaded 2D textures without transparent texels
+    std::unordered_set<unsigned int> opaqueTextures;
+    // per texture name the load its uploads belong to, main thread only
+    std::unordered_map<unsigned int, unsigned int> generations;
+    unsigned int lastGeneration = 0;
+
+    TextureLoader() = default;
+
+    void submit(Job *job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(job);
+            if (workers.empty())
+            {
+                // image decoding is the slow part, leave one core for the main thread's uploads
+                unsigned int cores = std::thread::hardware_concurrency();
+                unsigned int count = cores > 2 ? std::min(8u, cores - 1) : 1u;
+                for (unsigned int i = 0; i < count; i++)
+                    workers.emplace_back(&TextureLoader::work, this);
+            }
+        }
+        jobCondition.notify_one();
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            Job *job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobCondition.wait(lock, [this] { return stopping || !queued.empty(); });
+                if (stopping)
+                    return;
+                job = queued.front();
+                queued.pop_front();
+                running++;
+            }
+            // stb_image is reentrant apart from its error string, so decodes can run side by side
+            if (!job->source)
+            {
+                job->source = std::make_shared<MappedFile>();
+                job->source->Open(job->path);
+            }
+            if (job->source->IsOpen())
+            {
+                job->compressed = ParseDds(job->source->Data(), job->source->Size(), job->dds);
+                job->transparent = job->compressed && job->dds.format == BlockFormat::BC3;
+                if (!job->compressed)
+                {
+                    job->data = stbi_load_from_memory(job->source->Data(), (int)job->source->Size(), &job->width, &job->height, &job->nrComponents, 0);
+                    if (job->data && job->nrComponents == 4)
+                    {
+                        size_t pixels = (size_t)job->width * job->height;
+                        for (size_t i = 0; i < pixels && !job->transparent; i++)
+                            job->transparent = job->data[i * 4 + 3] != 255;
+                    }
+                    job->source.reset();
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                decoded.push_back(job);
+                running--;
+            }
+            finishedCondition.notify_all();
+        }
+    }
+
+    void upload(Job &job)
+    {
+        // the texture may have been released while it was still decoding, and its name reused since
+        auto current = generations.find(job.textureID);
+        if (current == generations.end() || current->second != job.generation)
+        {
+            stbi_image_free(job.data);
+            return;
+        }
+        if (job.compressed)
+        {
+            uploadCompressed(job);
+            if (job.target == GL_TEXTURE_2D && !job.transparent)
+                opaqueTextures.insert(job.textureID);
+            job.source.reset();
+            return;
+        }
+        if (!job.data)
+        {
+            if (job.target == GL_TEXTURE_2D)
+                std::cout << "Texture failed to load at path: " << job.path << std::endl;
+            else
+                std::cout << "Cubemap texture failed to load at path: " << job.path << std::endl;
+            return;
+        }
+
+        GLenum internalFormat = GL_RGB;
+        GLenum dataFormat = GL_RGB;
+        if (job.nrComponents == 1)
+        {
+            internalFormat = dataFormat = GL_RED;
+        }
+        else if (job.nrComponents == 3)
+        {
+            internalFormat = job.gamma ? GL_SRGB : GL_RGB;
+            dataFormat = GL_RGB;
+        }
+        else if (job.nrComponents == 4)
+        {
+            internalFormat = job.gamma ? GL_SRGB_ALPHA : GL_RGBA;
+            dataFormat = GL_RGBA;
+        }
+        // rows of 1 and 3 channel images are not necessarily 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        if (job.target == GL_TEXTURE_2D)
+        {
+            glBindTexture(GL_TEXTURE_2D, job.textureID);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, job.width, job.height, 0, dataFormat, GL_UNSIGNED_BYTE, job.data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            GLint wrap = job.clampAlpha && job.transparent ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            if (!job.transparent)
+                opaqueTextures.insert(job.textureID);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, job.textureID);
+            glTexImage2D(job.target, 0, GL_SRGB, job.width, job.height, 0, GL_RGB, GL_UNSIGNED_BYTE, job.data);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        stbi_image_free(job.data);
+        job.data = nullptr;
+    }
+
+    void uploadCompressed(Job &job)
+    {
+        const DdsImage &image = job.dds;
+        GLenum internalFormat = CompressedInternalFormat(image.format, job.gamma);
+        GLenum target = job.target;
+        if (target == GL_TEXTURE_2D)
+            glBindTexture(GL_TEXTURE_2D, job.textureID);
+        else
+            glBindTexture(GL_TEXTURE_CUBE_MAP, job.textureID);
+
+        unsigned int width = image.width, height = image.height;
+        for (unsigned int level = 0; level < image.levels.size(); level++)
+        {
+            glCompressedTexImage2D(target, level, internalFormat, width, height, 0, (GLsizei)image.levelSizes[level], image.levels[level]);
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        if (target != GL_TEXTURE_2D)
+            return;
+
+        // the mips come precomputed, a truncated chain just limits the sampled levels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+        GLint wrap = job.clampAlpha && job.transparent ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+};
+
+constexpr unsigned char TextureLoader::PLACEHOLDER[4];
+#endif
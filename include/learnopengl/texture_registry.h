@@ -0,0 +1,208 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/dds.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/texture_loader.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide owner of the GL textures loaded from files. Textures are keyed by the hash of the file contents
+// (plus the upload parameters), so byte-identical copies living under different paths share one GL texture. A hash
+// hit is only shared once the bytes compare equal, a collision moves the new texture to another key.
+// Every Acquire* has to be paired with a Release of the returned id; the texture is deleted with the last reference.
+// When the asset cooker has produced an up to date block compressed <image>.dds, that file is loaded instead.
+class TextureRegistry
+{
+public:
+    static TextureRegistry& Instance()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    unsigned int Acquire2D(const std::string &path, bool gamma, bool clampAlpha)
+    {
+        uint64_t params = (gamma ? 1u : 0u) | (clampAlpha ? 2u : 0u);
+        std::string pathKey = path + '#' + std::to_string(params);
+        auto known = byPath.find(pathKey);
+        if (known != byPath.end())
+            return addReference(known->second);
+
+        std::vector<std::string> files = {resolve(path)};
+        std::shared_ptr<MappedFile> source = std::make_shared<MappedFile>();
+        if (!source->Open(files[0]))
+        {
+            source = nullptr;
+            files[0] = path;
+        }
+        uint64_t hash = source ? HashBytes(source->Data(), source->Size(), params) : HashBytes(path.data(), path.size(), params);
+        uint64_t key = findKey(hash, params, files, {source});
+        byPath[pathKey] = key;
+        if (entries.count(key))
+            return addReference(key);
+
+        // a missing file still gets a (placeholder) texture, the loader reports the failure
+        unsigned int textureID = TextureLoader::Instance().Load2D(path, gamma, clampAlpha, source);
+        return addEntry(key, textureID, params, files);
+    }
+
+    unsigned int AcquireCubeMap(const std::vector<std::string> &faces)
+    {
+        const uint64_t CUBE_MAP = 4;
+        std::string pathKey = "cube";
+        for (const std::string &face : faces)
+            pathKey += '#' + face;
+        auto known = byPath.find(pathKey);
+        if (known != byPath.end())
+            return addReference(known->second);
+
+        uint64_t hash = HashBytes(&CUBE_MAP, sizeof(CUBE_MAP));
+        std::vector<std::string> files;
+        std::vector<std::shared_ptr<MappedFile>> sources;
+        for (const std::string &face : faces)
+        {
+            std::shared_ptr<MappedFile> source = std::make_shared<MappedFile>();
+            files.push_back(resolve(face));
+            if (source->Open(files.back()))
+                hash = HashBytes(source->Data(), source->Size(), hash);
+            else
+            {
+                hash = HashBytes(face.data(), face.size(), hash);
+                files.back() = face;
+            }
+            sources.push_back(source->IsOpen() ? source : nullptr);
+        }
+        uint64_t key = findKey(hash, CUBE_MAP, files, sources);
+        byPath[pathKey] = key;
+        if (entries.count(key))
+            return addReference(key);
+
+        unsigned int textureID = TextureLoader::Instance().LoadCubeMap(faces, sources);
+        return addEntry(key, textureID, CUBE_MAP, files);
+    }
+
+    void Release(unsigned int textureID)
+    {
+        auto owner = byID.find(textureID);
+        if (owner == byID.end())
+            return;
+        uint64_t key = owner->second;
+        Entry &entry = entries[key];
+        if (--entry.references > 0)
+            return;
+
+        TextureLoader::Instance().Cancel(textureID);
+        glDeleteTextures(1, &textureID);
+        entries.erase(key);
+        byID.erase(owner);
+        for (auto it = byPath.begin(); it != byPath.end();)
+        {
+            if (it->second == key)
+                it = byPath.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // deletes every texture regardless of references; call before the GL context goes away
+    void Clear()
+    {
+        for (auto &entry : entries)
+        {
+            TextureLoader::Instance().Cancel(entry.second.textureID);
+            glDeleteTextures(1, &entry.second.textureID);
+        }
+        entries.clear();
+        byPath.clear();
+        byID.clear();
+    }
+
+    // number of distinct GL textures currently alive
+    size_t TextureCount() const
+    {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        unsigned int textureID = 0;
+        unsigned int references = 0;
+        // what the texture was loaded from: the upload parameters and the file per image (the path for a missing one)
+        uint64_t params = 0;
+        std::vector<std::string> files;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    std::unordered_map<std::string, uint64_t> byPath;
+    std::unordered_map<unsigned int, uint64_t> byID;
+
+    TextureRegistry() = default;
+
+    // path of the file to actually load for a source image
+    static std::string resolve(const std::string &path)
+    {
+        if (CookedTextureUpToDate(path) && CompressedTexturesSupported())
+            return CookedTexturePath(path);
+        return path;
+    }
+
+    // the key of the entry with the same parameters and bytes as the given sources, or of a free slot. Colliding
+    // entries are stepped past by rehashing the key.
+    uint64_t findKey(uint64_t hash, uint64_t params, const std::vector<std::string> &files,
+                     const std::vector<std::shared_ptr<MappedFile>> &sources) const
+    {
+        uint64_t key = hash;
+        for (auto found = entries.find(key); found != entries.end(); found = entries.find(key))
+        {
+            if (sameSource(found->second, params, files, sources))
+                break;
+            key = HashBytes(&key, sizeof(key), key);
+        }
+        return key;
+    }
+
+    static bool sameSource(const Entry &entry, uint64_t params, const std::vector<std::string> &files,
+                           const std::vector<std::shared_ptr<MappedFile>> &sources)
+    {
+        if (entry.params != params || entry.files.size() != files.size())
+            return false;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (entry.files[i] == files[i])
+                continue;
+            MappedFile loaded;
+            if (!sources[i] || !loaded.Open(entry.files[i]) || loaded.Size() != sources[i]->Size() ||
+                std::memcmp(loaded.Data(), sources[i]->Data(), loaded.Size()) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    unsigned int addEntry(uint64_t key, unsigned int textureID, uint64_t params, const std::vector<std::string> &files)
+    {
+        Entry &entry = entries[key];
+        entry.textureID = textureID;
+        entry.references = 1;
+        entry.params = params;
+        entry.files = files;
+        byID[textureID] = key;
+        return textureID;
+    }
+
+    unsigned int addReference(uint64_t key)
+    {
+        Entry &entry = entries[key];
+        entry.references++;
+        return entry.textureID;
+    }
+};
+#endif
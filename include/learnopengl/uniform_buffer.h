@@ -0,0 +1,51 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+// Binding points of the uniform blocks shared by all programs. GLSL 3.30 can't declare the binding in the
+// shader, so every program maps its blocks with Shader::BindUniformBlock after linking.
+const unsigned int CAMERA_BLOCK_BINDING = 0;
+const unsigned int LIGHTS_BLOCK_BINDING = 1;
+
+// GPU copy of a std140 uniform block. T has to mirror the GLSL block byte for byte (vec3 padded to 16 bytes,
+// arrays and structs aligned to 16), the whole block is replaced with a single glBufferSubData per Update.
+template<typename T>
+class UniformBuffer
+{
+public:
+    unsigned int ID = 0;
+
+    explicit UniformBuffer(unsigned int binding) : binding(binding)
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    ~UniformBuffer()
+    {
+        glDeleteBuffers(1, &ID);
+    }
+
+    void Update(const T &data)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    unsigned int Binding() const
+    {
+        return binding;
+    }
+
+private:
+    unsigned int binding;
+};
+#endif
@@ -0,0 +1,50 @@
+#version 430 core
+// One direction of the separable bloom blur. Every work group blurs a segment of TILE pixels of one row (or column):
+// the segment and radius pixels on both sides are fetched once into shared memory, then each invocation sums its
+// neighbourhood from there instead of reading 2 * radius + 1 texels from the texture.
+#define TILE 128
+#define MAX_RADIUS 16
+layout (local_size_x = TILE) in;
+
+// the source can be larger than the destination (reduced resolution bloom), it is sampled bilinearly at the
+// destination texel centers; write-only images need no format qualifier, so any color format works
+layout (binding = 0) uniform sampler2D source;
+layout (binding = 0) uniform writeonly image2D destination;
+
+uniform bool horizontal;
+// first pass: keep only the pixels brighter than threshold (bright-pass extraction)
+uniform bool extractBright;
+uniform float threshold;
+uniform int radius;
+uniform float weight[MAX_RADIUS + 1];
+
+shared vec3 tile[TILE + 2 * MAX_RADIUS];
+
+void main()
+{
+    ivec2 size = imageSize(destination);
+    ivec2 direction = horizontal ? ivec2(1, 0) : ivec2(0, 1);
+    // x of the work group walks along the blur direction, y picks the row (or column)
+    int along = int(gl_WorkGroupID.x) * TILE;
+    int across = int(gl_WorkGroupID.y);
+    ivec2 start = horizontal ? ivec2(along, across) : ivec2(across, along);
+    int local = int(gl_LocalInvocationID.x);
+
+    for (int i = local; i < TILE + 2 * radius; i += TILE)
+    {
+        ivec2 texel = clamp(start + direction * (i - radius), ivec2(0), size - 1);
+        vec3 color = textureLod(source, (vec2(texel) + 0.5) / vec2(size), 0.0).rgb;
+        if (extractBright && dot(color, vec3(0.2126, 0.7152, 0.0722)) <= threshold)
+            color = vec3(0.0);
+        tile[i] = color;
+    }
+    barrier();
+
+    ivec2 pixel = start + direction * local;
+    if (pixel.x >= size.x || pixel.y >= size.y)
+        return;
+    vec3 result = tile[local + radius] * weight[0];
+    for (int i = 1; i <= radius; i++)
+        result += (tile[local + radius - i] + tile[local + radius + i]) * weight[i];
+    imageStore(destination, pixel, vec4(result, 1.0));
+}
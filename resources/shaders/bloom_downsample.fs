@@ -0,0 +1,39 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+
+// 13 bilinear taps around the center of the destination texel: a 4x4 box in the middle weighted 0.5
+// and four overlapping 2x2 boxes at the corners weighted 0.125 each, which keeps the downsample from
+// flickering when small bright spots move across texels
+void main()
+{
+    vec2 texel = 1.0 / textureSize(srcTexture, 0);
+    float x = texel.x;
+    float y = texel.y;
+
+    vec3 a = texture(srcTexture, TexCoords + vec2(-2.0 * x,  2.0 * y)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + vec2( 0.0,      2.0 * y)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + vec2( 2.0 * x,  2.0 * y)).rgb;
+
+    vec3 d = texture(srcTexture, TexCoords + vec2(-2.0 * x,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + vec2( 2.0 * x,  0.0)).rgb;
+
+    vec3 g = texture(srcTexture, TexCoords + vec2(-2.0 * x, -2.0 * y)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + vec2( 0.0,     -2.0 * y)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + vec2( 2.0 * x, -2.0 * y)).rgb;
+
+    vec3 j = texture(srcTexture, TexCoords + vec2(-x,  y)).rgb;
+    vec3 k = texture(srcTexture, TexCoords + vec2( x,  y)).rgb;
+    vec3 l = texture(srcTexture, TexCoords + vec2(-x, -y)).rgb;
+    vec3 m = texture(srcTexture, TexCoords + vec2( x, -y)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+    FragColor = vec4(result, 1.0);
+}
@@ -6,16 +6,29 @@ in vec2 TexCoords;
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
+// scales the blurred bright buffer, the mip chain bloom adds up every level
+uniform float bloomStrength;
 uniform float exposure;
 uniform bool hdr;
+// unsharp mask for the scene when it was rendered below the output resolution and gets upscaled here, 0 turns it off
+uniform float sharpness;
 
 void main()
 {
     const float gamma = 2.2;
     vec3 hdrColor = texture(scene, TexCoords).rgb;
+    if(sharpness > 0.0)
+    {
+        vec2 texel = 1.0 / textureSize(scene, 0);
+        vec3 neighbours = texture(scene, TexCoords + vec2(texel.x, 0.0)).rgb
+                        + texture(scene, TexCoords - vec2(texel.x, 0.0)).rgb
+                        + texture(scene, TexCoords + vec2(0.0, texel.y)).rgb
+                        + texture(scene, TexCoords - vec2(0.0, texel.y)).rgb;
+        hdrColor = max(hdrColor + sharpness * (hdrColor - 0.25 * neighbours), vec3(0.0));
+    }
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
     if(bloom)
-        hdrColor += bloomColor; // additive blending
+        hdrColor += bloomColor * bloomStrength; // additive blending
     if(hdr)
         {
             // reinhard
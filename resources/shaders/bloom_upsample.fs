@@ -0,0 +1,33 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+// radius of the tent filter in texels of srcTexture
+uniform float filterRadius;
+
+// 3x3 tent filter, added onto the larger level by the blend state
+void main()
+{
+    vec2 texel = filterRadius / textureSize(srcTexture, 0);
+    float x = texel.x;
+    float y = texel.y;
+
+    vec3 a = texture(srcTexture, TexCoords + vec2(-x,  y)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + vec2( 0.0, y)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + vec2( x,  y)).rgb;
+
+    vec3 d = texture(srcTexture, TexCoords + vec2(-x, 0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + vec2( x, 0.0)).rgb;
+
+    vec3 g = texture(srcTexture, TexCoords + vec2(-x, -y)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + vec2( 0.0, -y)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + vec2( x, -y)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -6,27 +6,22 @@ in vec2 TexCoords;
 uniform sampler2D image;
 
 uniform bool horizontal;
-uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
+// linear sampling kernel generated on the CPU (GaussianKernel), offsets in texels; tap 0 is the center texel,
+// every other one is fetched on both sides and covers two texels through the bilinear filter
+#define MAX_TAPS 8
+uniform int taps;
+uniform float weight[MAX_TAPS];
+uniform float offset[MAX_TAPS];
 
 void main()
 {             
      vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
+     vec2 direction = horizontal ? vec2(tex_offset.x, 0.0) : vec2(0.0, tex_offset.y);
      vec3 result = texture(image, TexCoords).rgb * weight[0];
-     if(horizontal)
+     for(int i = 1; i < taps; ++i)
      {
-         for(int i = 1; i < 5; ++i)
-         {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-         }
-     }
-     else
-     {
-         for(int i = 1; i < 5; ++i)
-         {
-             result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-             result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-         }
+         result += texture(image, TexCoords + direction * offset[i]).rgb * weight[i];
+         result += texture(image, TexCoords - direction * offset[i]).rgb * weight[i];
      }
      FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
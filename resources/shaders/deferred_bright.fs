@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 BrightColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+// luminance above which a pixel goes into the bloom buffer
+uniform float bloomThreshold;
+
+// the bright color of the lit G-buffer, what object_shader.fs writes per fragment in the forward path
+void main()
+{
+    vec3 result = texelFetch(scene, ivec2(gl_FragCoord.xy), 0).rgb;
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > bloomThreshold)
+        BrightColor = vec4(result, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
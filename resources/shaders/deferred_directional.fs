@@ -0,0 +1,127 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+// std140, the same blocks as in object_shader.fs
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+struct Clusters {
+    vec2 tileSize;
+    float depthScale;
+    float depthBias;
+    int gridX;
+    int gridY;
+    int gridZ;
+    int lightCount;
+};
+
+in vec2 TexCoords;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    bool lightOn;
+    Clusters clusters;
+};
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gSpecular;
+uniform sampler2D gNormalDepth;
+uniform float shininess;
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor);
+vec3 WorldPosition(float viewDepth);
+
+// the lights that reach every pixel: the directional light and the flashlight. Pixels nothing was drawn into
+// keep the cleared color.
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 normalDepth = texelFetch(gNormalDepth, pixel, 0);
+    if(normalDepth.w == 0.0)
+        discard;
+    vec3 albedo = texelFetch(gAlbedo, pixel, 0).rgb;
+    vec3 specularColor = texelFetch(gSpecular, pixel, 0).rgb;
+    vec3 norm = normalDepth.xyz;
+    vec3 fragPos = WorldPosition(normalDepth.w);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, albedo, specularColor);
+    if(lightOn)
+        result += CalcSpotLight(spotLight, norm, fragPos, viewDir, albedo, specularColor);
+
+    // the point lights are added on top, the bright color is extracted from the sum afterwards
+    FragColor = vec4(result, 1.0);
+    BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+// back from the view depth along the pixel's view ray, the view matrix is a rotation and a translation
+vec3 WorldPosition(float viewDepth)
+{
+    vec2 ndc = gl_FragCoord.xy / vec2(textureSize(gNormalDepth, 0)) * 2.0 - 1.0;
+    vec3 viewRay = vec3(ndc.x / projection[0][0], ndc.y / projection[1][1], -1.0);
+    return viewPos + transpose(mat3(view)) * viewRay * viewDepth;
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
@@ -0,0 +1,85 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float radius;
+};
+
+flat in int Light;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+uniform samplerBuffer lightData;
+uniform sampler2D gAlbedo;
+uniform sampler2D gSpecular;
+uniform sampler2D gNormalDepth;
+uniform float shininess;
+
+PointLight FetchPointLight(int index);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor);
+vec3 WorldPosition(float viewDepth);
+
+// one light's contribution to a pixel its volume covers, added onto the scene color
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 normalDepth = texelFetch(gNormalDepth, pixel, 0);
+    if(normalDepth.w == 0.0)
+        discard;
+    vec3 albedo = texelFetch(gAlbedo, pixel, 0).rgb;
+    vec3 specularColor = texelFetch(gSpecular, pixel, 0).rgb;
+    vec3 fragPos = WorldPosition(normalDepth.w);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    FragColor = vec4(CalcPointLight(FetchPointLight(Light), normalDepth.xyz, fragPos, viewDir, albedo, specularColor), 0.0);
+    BrightColor = vec4(0.0);
+}
+
+// back from the view depth along the pixel's view ray, the view matrix is a rotation and a translation
+vec3 WorldPosition(float viewDepth)
+{
+    vec2 ndc = gl_FragCoord.xy / vec2(textureSize(gNormalDepth, 0)) * 2.0 - 1.0;
+    vec3 viewRay = vec3(ndc.x / projection[0][0], ndc.y / projection[1][1], -1.0);
+    return viewPos + transpose(mat3(view)) * viewRay * viewDepth;
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 texel0 = texelFetch(lightData, index * 4);
+    vec4 texel1 = texelFetch(lightData, index * 4 + 1);
+    vec4 texel2 = texelFetch(lightData, index * 4 + 2);
+    vec4 texel3 = texelFetch(lightData, index * 4 + 3);
+    return PointLight(texel0.xyz, texel0.w, texel1.xyz, texel1.w, texel2.xyz, texel2.w, texel3.xyz, texel3.w);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularColor)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // attenuation, faded out towards the radius like in object_shader.fs
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular) * attenuation;
+}
@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+flat out int Light;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// all point lights, four texels each
+uniform samplerBuffer lightData;
+// the sphere mesh lies inside the unit sphere, this much larger it covers it
+uniform float inflate;
+
+// one instance per light: the sphere mesh around the light, scaled to its radius. Lights without a radius
+// collapse to a point, unbounded ones are capped far beyond the far plane.
+void main()
+{
+    vec4 positionConstant = texelFetch(lightData, gl_InstanceID * 4);
+    float radius = min(texelFetch(lightData, gl_InstanceID * 4 + 3).w, 10000.0);
+    Light = gl_InstanceID;
+    gl_Position = projection * view * vec4(positionConstant.xyz + aPos * radius * inflate, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// the main pass tests against these depths with GL_EQUAL, so the position is computed exactly like in object_shader.vs
+invariant gl_Position;
+
+void main()
+{
+    vec3 fragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
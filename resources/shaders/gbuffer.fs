@@ -0,0 +1,33 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gSpecular;
+layout (location = 2) out vec4 gNormalDepth;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+uniform Material material;
+
+// the surface attributes the deferred lighting needs, see include/learnopengl/deferred.h. The view depth is
+// never 0 for a drawn surface, a cleared texel means nothing is there.
+void main()
+{
+    vec4 texColor = texture(material.diffuse, TexCoords);
+    if(texColor.a < 0.1)
+        discard;
+    gAlbedo = vec4(texColor.rgb, 1.0);
+    gSpecular = vec4(texture(material.specular, TexCoords).rgb, 1.0);
+    gNormalDepth = vec4(normalize(Normal), -(view * vec4(FragPos, 1.0)).z);
+}
@@ -8,6 +8,8 @@ struct Material {
     float shininess;
 }; 
 
+// the light structs are laid out std140 so they match the C++ side of the Lights block,
+// every vec3 shares its 16 byte slot with the following float. Point lights come from the light buffer instead.
 struct DirLight {
     vec3 direction;
 	
@@ -18,52 +20,73 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
+    float radius;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-  
+    vec3 ambient;
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
 };
 
-#define NR_POINT_LIGHTS 3
-#define NR_CANDLES 2
+// where the fragment finds its cluster, see include/learnopengl/light_clusters.h
+struct Clusters {
+    vec2 tileSize;
+    float depthScale;
+    float depthBias;
+    int gridX;
+    int gridY;
+    int gridZ;
+    int lightCount;
+};
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform PointLight candles[NR_CANDLES];
-uniform SpotLight spotLight;
-uniform bool lightOn;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    bool lightOn;
+    Clusters clusters;
+};
+
+// all point lights, four texels each
+uniform samplerBuffer lightData;
+// per cluster the offset of its first index in lightIndices and the number of lights
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
 
 
 uniform Material material;
+// luminance above which a fragment goes into the bloom buffer
+uniform float bloomThreshold;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+PointLight FetchPointLight(int index);
+int ClusterIndex();
 
 void main()
 {    
@@ -79,11 +102,13 @@ void main()
     // == =====================================================
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
-    for (int i=0;i<NR_CANDLES;i++)
-        result += CalcPointLight(candles[i], norm, FragPos, viewDir);
+    // phase 2: point lights, only the ones binned into this fragment's cluster
+    uvec2 lightRange = texelFetch(lightClusters, ClusterIndex()).rg;
+    for(uint i = 0u; i < lightRange.y; i++)
+    {
+        int light = int(texelFetch(lightIndices, int(lightRange.x + i)).r);
+        result += CalcPointLight(FetchPointLight(light), norm, FragPos, viewDir);
+    }
     // phase 3: spot light
     if(lightOn)
         result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
@@ -92,7 +117,7 @@ void main()
         discard;
 
     float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-        if(brightness > 1.0)
+        if(brightness > bloomThreshold)
             BrightColor = vec4(result, 1.0);
         else
             BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
@@ -116,6 +141,26 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     return (ambient + diffuse + specular);
 }
 
+// the cluster of this fragment, from its pixel and its view depth
+int ClusterIndex()
+{
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusters.tileSize);
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    int slice = int(floor(log(viewDepth) * clusters.depthScale - clusters.depthBias));
+    tile = clamp(tile, ivec2(0), ivec2(clusters.gridX - 1, clusters.gridY - 1));
+    slice = clamp(slice, 0, clusters.gridZ - 1);
+    return tile.x + tile.y * clusters.gridX + slice * clusters.gridX * clusters.gridY;
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 texel0 = texelFetch(lightData, index * 4);
+    vec4 texel1 = texelFetch(lightData, index * 4 + 1);
+    vec4 texel2 = texelFetch(lightData, index * 4 + 2);
+    vec4 texel3 = texelFetch(lightData, index * 4 + 3);
+    return PointLight(texel0.xyz, texel0.w, texel1.xyz, texel1.w, texel2.xyz, texel2.w, texel3.xyz, texel3.w);
+}
+
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -128,6 +173,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // fade to zero at the radius the light was binned with, so it doesn't end at a cluster border
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
@@ -9,13 +9,33 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <learnopengl/bloom.h>
+#include <learnopengl/deferred.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/headless_context.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/lod.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/render_targets.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/scene_file.h>
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 
 #include <learnopengl/model.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/uniform_buffer.h>
 
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <map>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
@@ -25,6 +45,7 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 unsigned int loadTexture(char const * path,bool gammaCorrection);
 unsigned int loadCubeMap(vector<std::string> faces);
 void renderQuad();
+void scriptedCamera(Camera &camera, double time);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -41,6 +62,20 @@ bool hdr = false;
 bool hdrKeyPressed = false;
 bool bloom = true;
 bool bloomKeyPressed = false;
+// the original full resolution ping-pong Gaussian blur, or the downsample/upsample chain
+enum BloomMode {
+    BLOOM_GAUSSIAN,
+    BLOOM_MIP_CHAIN,
+    // the Gaussian blur in compute shaders, needs OpenGL 4.3 and falls back to BLOOM_GAUSSIAN otherwise
+    BLOOM_COMPUTE
+};
+int bloomMode = BLOOM_MIP_CHAIN;
+float bloomThreshold = 1.0f;
+int bloomMips = 6;
+// Gaussian blur kernel, uploaded to blurShader again whenever the UI changes it
+float blurSigma = 1.75f;
+int blurRadius = 4;
+bool blurKernelChanged = true;
 
 float exposure = 1.5f;
 
@@ -48,39 +83,108 @@ float exposure = 1.5f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// framebuffer that ends up on screen, the offscreen target in headless mode
+unsigned int defaultFramebuffer = 0;
+// size of defaultFramebuffer, the scene renders at this size times the render scale
+unsigned int windowWidth = SCR_WIDTH;
+unsigned int windowHeight = SCR_HEIGHT;
+DynamicResolution dynamicResolution;
+// unsharp mask strength for the upscaled scene while the render scale is below 1
+float upscaleSharpness = 0.5f;
+// render target format policy: color format of all HDR targets and how much smaller the bloom targets are
+const GLenum hdrFormats[] = {GL_RGBA16F, GL_R11F_G11F_B10F};
+int hdrFormat = 1;
+int bloomDivisor = 2;
+// video memory of the render targets and the bloom chain, for the UI
+size_t renderTargetMemory = 0;
+// objects outside the view frustum are skipped, the counts of the last frame are shown in the UI
+bool frustumCulling = true;
+CullStats cullStats;
+// picks the simplified meshes for distant placements, its counts of the last frame are shown in the UI
+LodSelector lodSelector;
+// world matrices the scene recomputed last frame out of how many entities it has, for the UI
+unsigned int transformsUpdated = 0;
+unsigned int sceneEntities = 0;
+// how long the last scene load took and whether it read the cooked file
+float sceneLoadMilliseconds = 0.0f;
+bool sceneLoadedCooked = false;
+// draw calls the render queue needed last frame for how many packets and those of the depth pre-pass, for the UI
+unsigned int sceneDrawCalls = 0;
+unsigned int scenePackets = 0;
+unsigned int depthDrawCalls = 0;
+// small point lights scattered over the island on top of the scene's, to see how the clustered lighting scales
+int testLights = 0;
+// what the light clusters held last frame, for the UI
+struct {
+    unsigned int lights = 0;
+    unsigned int indices = 0;
+    unsigned int maxPerCluster = 0;
+    unsigned int dropped = 0;
+} lightStats;
+// opaque models are drawn into the depth buffer first, so the lit pass only shades the visible surfaces
+bool depthPrepass = false;
+// opaque models go through the G-buffer and are lit per covered pixel instead of per drawn fragment
+bool deferredShading = false;
+
+// the light structs mirror the std140 layout of the Lights block in object_shader.fs,
+// so they are copied into the uniform buffer as they are. Point lights are clustered, see light_clusters.h.
 struct DirLight {
     glm::vec3 direction;
+    float padding0;
 
     glm::vec3 ambient;
+    float padding1;
     glm::vec3 diffuse;
+    float padding2;
     glm::vec3 specular;
-};
-struct PointLight {
-    glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
+    float padding3;
 };
 struct SpotLight {
     glm::vec3 position;
-    glm::vec3 direction;
     float cutOff;
+    glm::vec3 direction;
     float outerCutOff;
 
+    glm::vec3 ambient;
     float constant;
+    glm::vec3 diffuse;
     float linear;
+    glm::vec3 specular;
     float quadratic;
+};
 
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
+// std140 uniform blocks shared by all programs, updated once per frame
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float padding;
+};
+struct LightsBlock {
+    DirLight dirLight;
+    SpotLight spotLight;
+    int lightOn;
+    int padding[3];
+    ClusterInfo clusters;
+};
+static_assert(sizeof(DirLight) == 64 && sizeof(SpotLight) == 80, "light structs must match std140");
+static_assert(sizeof(CameraBlock) == 144 && sizeof(LightsBlock) == 192, "uniform blocks must match std140");
+
+void updateLights(LightsBlock &lights, vector<PointLight> &pointLights, const DirLight &dirLight, const PointLight &pointLight,
+                  const SpotLight &spotLight, const vector<glm::vec3> &lightPositions, const vector<glm::vec3> &candlePositions, bool hdr);
+void addTestLights(vector<PointLight> &pointLights, unsigned int count);
+
+// entities the render loop draws by hand or animates, found by model name when the scene is built
+struct SceneEntities {
+    vector<Scene::Entity> plants;
+    vector<Scene::Entity> portals;
+    vector<Scene::Entity> water;
+    vector<Scene::Entity> floating;
 };
 
-void setShader(Shader myShader, DirLight dirLight, PointLight pointLight, SpotLight spotLight, vector<glm::vec3> lightPos,bool hdr);
+bool loadScene(SceneDescription &description, const std::string &path);
+void buildScene(const SceneDescription &description, std::map<std::string, std::unique_ptr<Model>> &loadedModels,
+                vector<Model*> &drawnModels, Scene &scene, SceneEntities &entities);
 
 
 struct ProgramState {
@@ -160,69 +264,123 @@ void ProgramState::LoadFromFile(std::string filename) {
 }
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
-
-int main() {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+void DrawImGui(ProgramState *programState, const Profiler &profiler);
+
+int main(int argc, char **argv) {
+    // command line: --headless renders offscreen without a window (EGL surfaceless), --frames N stops after
+    // N frames (300 by default when headless), --screenshot file.ppm saves the last headless frame and
+    // --trace file.json writes the per-pass timings of the whole run as a Chrome trace, --scene file.scene
+    // renders another scene description than resources/island.scene, --lights N adds N test point lights,
+    // --deferred starts with deferred shading, --depth-prepass with the depth pre-pass and --no-lod draws every
+    // model at full detail
+    bool headless = false;
+    unsigned int frameLimit = 0;
+    std::string screenshotPath;
+    std::string tracePath;
+    std::string scenePath = "resources/island.scene";
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--headless")
+            headless = true;
+        else if (arg == "--frames" && i + 1 < argc)
+            frameLimit = (unsigned int)std::atoi(argv[++i]);
+        else if (arg == "--screenshot" && i + 1 < argc)
+            screenshotPath = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (arg == "--scene" && i + 1 < argc)
+            scenePath = argv[++i];
+        else if (arg == "--lights" && i + 1 < argc)
+            testLights = std::max(std::atoi(argv[++i]), 0);
+        else if (arg == "--deferred")
+            deferredShading = true;
+        else if (arg == "--depth-prepass")
+            depthPrepass = true;
+        else if (arg == "--no-lod")
+            lodSelector.Enabled = false;
+        else
+            std::cout << "Unknown argument: " << arg << std::endl;
+    }
+    if (headless && frameLimit == 0)
+        frameLimit = 300;
+
+    GLFWwindow *window = nullptr;
+    HeadlessContext headlessContext;
+    if (headless) {
+        if (!headlessContext.Create(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
+        defaultFramebuffer = headlessContext.Framebuffer();
+    } else {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Project", nullptr, nullptr);
-    if (window == nullptr) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Project", nullptr, nullptr);
+        if (window == nullptr) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        // the framebuffer can be larger than the window on high DPI displays
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        windowWidth = (unsigned int)framebufferWidth;
+        windowHeight = (unsigned int)framebufferHeight;
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+        GLExt::Instance().Load((GLADloadproc) glfwGetProcAddress);
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // blending is switched on for the blended draws only, by the render queue
+    GLState::Instance().SetEnabled(GL_DEPTH_TEST, true);
+    GLState::Instance().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
-    if (programState->ImGuiEnabled) {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-    }
-    // Init Imgui
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO &io = ImGui::GetIO();
-    (void) io;
+    // headless runs always start from the same state and have no UI
+    if (!headless) {
+        programState->LoadFromFile("resources/program_state.txt");
+        if (programState->ImGuiEnabled) {
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        }
+        // Init Imgui
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO &io = ImGui::GetIO();
+        (void) io;
 
 
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330 core");
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+    }
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    GLState::Instance().SetEnabled(GL_DEPTH_TEST, true);
 
     //light
     DirLight& dirLight = programState->dirLight;
@@ -256,41 +414,61 @@ int main() {
 
     //Shaders
     Shader objShader("resources/shaders/object_shader.vs","resources/shaders/object_shader.fs");
+    Shader gbufferShader("resources/shaders/object_shader.vs","resources/shaders/gbuffer.fs");
+    Shader depthShader("resources/shaders/depth_prepass.vs","resources/shaders/depth_prepass.fs");
     Shader skyboxShader("resources/shaders/skybox.vs","resources/shaders/skybox.fs");
     Shader waterShader("resources/shaders/water_blending.vs","resources/shaders/water_blending.fs");
     Shader discardShader("resources/shaders/discard_shader.vs","resources/shaders/discard_shader.fs");
     Shader blurShader("resources/shaders/blur.vs","resources/shaders/blur.fs");
     Shader bloomShader("resources/shaders/bloom_final.vs","resources/shaders/bloom_final.fs");
 
+    // camera and lights live in uniform buffers shared by every program
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<LightsBlock> lightsBuffer(LIGHTS_BLOCK_BINDING);
+    CameraBlock cameraBlock = {};
+    LightsBlock lightsBlock = {};
+    // point lights of the frame, binned into view space clusters that object_shader.fs reads from texture buffers
+    LightClusters lightClusters;
+    vector<PointLight> pointLights;
+    LightClusters::SetSamplers(objShader);
+    for (Shader *shader : {&objShader, &gbufferShader, &depthShader, &skyboxShader, &waterShader, &discardShader}) {
+        shader->BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+        shader->BindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+    }
+    const float shininess = 32.0f;
+    objShader.use();
+    objShader.setFloat("material.shininess", shininess);
+    // the deferred path lights the G-buffer gbufferShader fills
+    DeferredLighting deferredLighting(shininess);
+
+    UniformHandle discardModel = discardShader.uniform("model");
+    UniformHandle waterModel = waterShader.uniform("model");
+    UniformHandle waterCurrentFrame = waterShader.uniform("currentFrame");
+    UniformHandle skyboxSampler = skyboxShader.uniform("skybox");
+    UniformHandle blurHorizontal = blurShader.uniform("horizontal");
+    UniformHandle blurTaps = blurShader.uniform("taps");
+    UniformHandle blurWeights = blurShader.uniform("weight");
+    UniformHandle blurOffsets = blurShader.uniform("offset");
+    UniformHandle bloomHdr = bloomShader.uniform("hdr");
+    UniformHandle bloomEnabled = bloomShader.uniform("bloom");
+    UniformHandle bloomExposure = bloomShader.uniform("exposure");
+    UniformHandle bloomStrength = bloomShader.uniform("bloomStrength");
+    UniformHandle bloomSharpness = bloomShader.uniform("sharpness");
+    UniformHandle objBloomThreshold = objShader.uniform("bloomThreshold");
 
 
-    //Models
-    Model island("resources/objects/island/island.obj",true);
-    island.SetShaderTextureNamePrefix("material.");
-
-    Model crystal("resources/objects/crystals/crystal5.obj",true);
-    crystal.SetShaderTextureNamePrefix("material.");
-
-    Model tree("resources/objects/BlueTree/BlueTree.obj",true);
-    tree.SetShaderTextureNamePrefix("material.");
-
-    Model stomp("resources/objects/stomp/BlueStump.obj",true);
-    stomp.SetShaderTextureNamePrefix("material.");
-
-    Model lamp("resources/objects/lamp/lamp.obj",true);
-    lamp.SetShaderTextureNamePrefix("material.");
-
-    Model lightCrystal("resources/objects/crystals/crystal4.obj",true);
-    lightCrystal.SetShaderTextureNamePrefix("material.");
-
-    Model arch("resources/objects/Arch/stoneArch.obj",true);
-    arch.SetShaderTextureNamePrefix("material.");
-
-    Model platform("resources/objects/Platform/StonePlatform.obj",true);
-    platform.SetShaderTextureNamePrefix("material.");
 
-    Model stone("resources/objects/stone/stone.obj",true);
-    stone.SetShaderTextureNamePrefix("material.");
+    //Models
+    // what to load and where it goes comes from the scene file, every model is loaded once per path and kept
+    // when the scene is reloaded
+    SceneDescription sceneDescription;
+    loadScene(sceneDescription, scenePath);
+    time_t sceneModified = SceneDescription::ModifiedTime(scenePath);
+    std::map<std::string, std::unique_ptr<Model>> loadedModels;
+    vector<Model*> drawnModels;
+    Scene scene;
+    SceneEntities entities;
+    buildScene(sceneDescription, loadedModels, drawnModels, scene, entities);
 
 
 
@@ -421,56 +599,15 @@ int main() {
     //BLOOM
     // configure (floating point) framebuffers
 
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    // create 2 floating point color buffers (1 for normal rendering, other for brightness threshold values)
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    // floating point framebuffers, sized to the window times the render scale at the start of every frame.
+    // Resizing keeps the object names, so the aliases below stay valid.
+    RenderTargets renderTargets;
+    renderTargets.Resize(windowWidth, windowHeight, hdrFormats[hdrFormat], (unsigned int)bloomDivisor, deferredShading);
+    unsigned int hdrFBO = renderTargets.HdrFramebuffer;
+    const unsigned int *colorBuffers = renderTargets.ColorBuffers;
+    const unsigned int *pingpongFBO = renderTargets.PingpongFramebuffers;
+    const unsigned int *pingpongColorbuffers = renderTargets.PingpongColorbuffers;
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
 
     // shader configuration
     blurShader.use();
@@ -479,43 +616,25 @@ int main() {
     bloomShader.setInt("scene", 0);
     bloomShader.setInt("bloomBlur", 1);
 
+    BloomMipChain bloomMipChain(renderTargets.BloomWidth(), renderTargets.BloomHeight());
+    std::unique_ptr<ComputeBloom> computeBloom;
+    if (GLExt::Instance().ComputeSupported())
+        computeBloom.reset(new ComputeBloom());
 
-    vector<glm::vec3> pointLightPositions = {
-            glm::vec3(1.2f, 3.35f, -0.5f),
-            glm::vec3(1.2f, 3.36f, 0.4f),
-            glm::vec3(-1.64f, 4.43f+sin(glfwGetTime())*0.02, -0.35f),
-            glm::vec3(-0.6f, 3.0f, -0.77f),
-            glm::vec3(-0.1f, 2.8f, 0.87f)
-    };
-
-
-
-
-    glm::vec3 crystalsPositions[] = {
-            glm::vec3(-0.1f, 3.02f, 0.87f),
-            glm::vec3(-0.6f, 3.0f, -0.77f)
 
-    };
+    const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
 
-    vector<glm::vec3> plants
-            {
-                    glm::vec3(1.55f, 3.22f, -0.42f),
-                    glm::vec3(1.24f, 3.2f, 0.33f),
-                    glm::vec3(-0.7f, 3.2f, 1.1f),
-                    glm::vec3(-0.2f, 3.2f, -1.0f),
-                    glm::vec3(-1.85f, 4.18f, -0.6f),
-                    glm::vec3(0.1f, 3.2f, 0.9f),
-                    glm::vec3(-0.73f, 3.2f, 0.1f)
-
-            };
-
-    vector<glm::vec3> waterSquares
-            {
-                    glm::vec3(-25.0f, 0.0f, -25.0f),
-                    glm::vec3(-25.0f, 0.0f, 25.0f),
-                    glm::vec3(25.0f, 0.0f, -25.0f),
-                    glm::vec3(25.0f, 0.0f, 25.0f)
-            };
+    // object space bounds of the plant/portal quad and of a water square, for frustum culling
+    AABB quadBounds;
+    quadBounds.Extend(glm::vec3(-0.5f, -0.5f, 0.0f));
+    quadBounds.Extend(glm::vec3(0.5f, 0.5f, 0.0f));
+    BoundingSphere quadSphere;
+    quadSphere.radius = glm::length(quadBounds.max);
+    AABB waterBounds;
+    waterBounds.Extend(glm::vec3(-25.0f, 0.0f, -25.0f));
+    waterBounds.Extend(glm::vec3(25.0f, 0.0f, 25.0f));
+    BoundingSphere waterSphere;
+    waterSphere.radius = glm::length(waterBounds.max);
 
     vector<std::string> faces
             {
@@ -529,256 +648,308 @@ int main() {
     unsigned int cubeMapTexture = loadCubeMap(faces);
 
 
+    // per-pass CPU/GPU timings, shown in the ImGui profiler panel and reported at the end of headless runs
+    Profiler profiler;
+    if (!tracePath.empty())
+        profiler.EnableTrace();
+    if (headless)
+        TextureLoader::Instance().Finish(); // measure the steady state, not the texture streaming
+
     // render loop
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
+    unsigned int frameIndex = 0;
+    float lastSceneCheck = 0.0f;
+    RenderQueue renderQueue;
+    while ((headless || !glfwWindowShouldClose(window)) && (frameLimit == 0 || frameIndex < frameLimit)) {
+        // per-frame time logic, headless runs advance a fixed 1/60 s per frame so every run renders the same images
         // --------------------
-        float currentFrame = glfwGetTime();
+        float currentFrame = headless ? frameIndex / 60.0f : (float)glfwGetTime();
         deltaTime = (float)currentFrame - lastFrame;
         lastFrame = (float)currentFrame;
+        frameIndex++;
+        profiler.BeginFrame();
+
+        // upload textures that finished decoding in the background
+        TextureLoader::Instance().Update();
 
         // input
-        processInput(window);
-        setShader(objShader, dirLight, pointLight, spotLight, pointLightPositions,hdr);
+        if (headless)
+            scriptedCamera(programState->camera, currentFrame);
+        else
+            processInput(window);
+
+        // internal resolution: the window times the render scale, which the controller picks from the GPU time
+        // of the last finished frame. Targets are only reallocated when the size actually changes.
+        dynamicResolution.Update(profiler.Frame().LastGpu());
+        renderTargets.Resize((unsigned int)(windowWidth * dynamicResolution.Scale + 0.5f),
+                             (unsigned int)(windowHeight * dynamicResolution.Scale + 0.5f),
+                             hdrFormats[hdrFormat], (unsigned int)bloomDivisor, deferredShading);
+        bloomMipChain.Resize(renderTargets.BloomWidth(), renderTargets.BloomHeight(), renderTargets.Format());
+        renderTargetMemory = renderTargets.MemoryBytes() + bloomMipChain.MemoryBytes(ColorFormatBytes(renderTargets.Format()));
 
         // render
         glClearColor(0.0f,0.0f,0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // every block below is timed on its own, the profiler's scopes are flat
+        profiler.Begin("clear");
         glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        glViewport(0, 0, renderTargets.Width(), renderTargets.Height());
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        profiler.End();
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
-
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),(float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+        const float nearPlane = 0.1f, farPlane = 100.0f;
+        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),(float) renderTargets.Width() / (float) renderTargets.Height(), nearPlane, farPlane);
         glm::mat4 view = programState->camera.GetViewMatrix();
 
-        //island
-        objShader.use();
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(0.2f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        island.Draw(objShader);
-
-       //crystals
-        for(auto &crystalsPosition: crystalsPositions){
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, crystalsPosition); // translate it down so it's at the center of the scene
-            model = glm::scale(model, glm::vec3(0.15f));	// it's a bit too big for our scene, so scale it down
-            objShader.setMat4("model", model);
-            crystal.Draw(objShader);
+        // per-frame state shared by all programs, one buffer update each
+        cameraBlock.projection = projection;
+        cameraBlock.view = view;
+        cameraBlock.viewPosition = programState->camera.Position;
+        cameraBuffer.Update(cameraBlock);
+        Frustum frustum = frustumCulling ? Frustum(projection * view) : Frustum();
+        cullStats.Reset();
+        lodSelector.Begin(programState->camera.Position, glm::radians(programState->camera.Zoom), (float)renderTargets.Height());
+        profiler.Begin("lights");
+        updateLights(lightsBlock, pointLights, dirLight, pointLight, spotLight, sceneDescription.lights, sceneDescription.candles, hdr);
+        addTestLights(pointLights, (unsigned int)testLights);
+        lightClusters.Update(pointLights, view, projection, nearPlane, farPlane, renderTargets.Width(), renderTargets.Height());
+        lightsBlock.clusters = lightClusters.Info();
+        lightsBuffer.Update(lightsBlock);
+        lightStats.lights = (unsigned int)lightClusters.Info().lightCount;
+        lightStats.indices = lightClusters.IndexCount();
+        lightStats.maxPerCluster = lightClusters.MaxPerCluster();
+        lightStats.dropped = lightClusters.Dropped();
+        profiler.End();
+
+        // pick up edits of the scene file, a file that doesn't parse keeps the current scene
+        if (!headless && currentFrame - lastSceneCheck > 0.5f) {
+            lastSceneCheck = currentFrame;
+            time_t modified = SceneDescription::ModifiedTime(scenePath);
+            if (modified != sceneModified) {
+                sceneModified = modified;
+                if (loadScene(sceneDescription, scenePath))
+                    buildScene(sceneDescription, loadedModels, drawnModels, scene, entities);
+            }
         }
 
-        // tree
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-0.6f, 2.85f, 0.6f));
-        model = glm::rotate(model,glm::radians(90.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.25f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        tree.Draw(objShader);
-
-
-        //arch
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.57f, 3.0f, -0.024f));
-        model = glm::scale(model, glm::vec3(0.205f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        arch.Draw(objShader);
-
-        //platform
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.55f, 2.73f, -0.45f));
-        model = glm::scale(model, glm::vec3(0.205f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        platform.Draw(objShader);
-
-        //stone1
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-0.5f, 2.93f, -1.55f));
-        model = glm::rotate(model,glm::radians(20.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.14f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        stone.Draw(objShader);
-
-        //stone2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-0.3f, 2.82f, 1.63f));
-        model = glm::rotate(model,glm::radians(180.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.14f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        stone.Draw(objShader);
-
-        //stone3
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-2.05f, 4.0f, -0.35f));
-        model = glm::rotate(model,glm::radians(90.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.06f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        stone.Draw(objShader);
-
-        //stomp1
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-1.55f, 2.9f, -0.2f));
-        model = glm::scale(model, glm::vec3(0.11f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        stomp.Draw(objShader);
-
-        //stomp2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-1.64f, 4.0f, -0.35f));
-        model = glm::rotate(model,glm::radians(70.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.11f));	// it's a bit too big for our scene, so scale it down
-        objShader.setMat4("model", model);
-        stomp.Draw(objShader);
-
-        //lamp1
-        objShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.2f, 3.07f, -0.5f));
-        model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.3f));
-        objShader.setMat4("model", model);
-        lamp.Draw(objShader);
-
-        //lamp2
+        // the animated entities (an entity is the index of its instance), everything else keeps its cached world matrix
+        for (Scene::Entity entity : entities.floating) {
+            glm::vec3 position = sceneDescription.instances[entity].position;
+            position.y += sin(currentFrame)*0.02;
+            scene.SetPosition(entity, position);
+        }
+        for (Scene::Entity entity : entities.portals) {
+            glm::quat facing = glm::angleAxis(glm::radians(sceneDescription.instances[entity].yaw), yAxis);
+            scene.SetRotation(entity, facing * glm::angleAxis((float)(currentFrame*0.05), glm::vec3(0.0f, 0.0f, 1.0f)));
+        }
+        scene.UpdateTransforms();
+        transformsUpdated = scene.LastUpdated();
+        sceneEntities = (unsigned int)scene.Size();
+
+        // texture uploads and model loading bind behind the state cache's back, start this frame's counts with a clean cache
+        GLState::Instance().NewFrame();
+
+        // collect every visible draw into the queue, sorted by pass, program and material when it is submitted
+        profiler.Begin("queue");
+        renderQueue.Begin(programState->camera.Position);
+        GeometryArena::Instance().BeginFrame();
+        // per-frame uniforms are program state, they stay set until the queued draws use the program
         objShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.2f, 3.05f, 0.4f));
-        model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.3f));
-        objShader.setMat4("model", model);
-        lamp.Draw(objShader);
-
-
-        //light crystal
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-1.64f, 4.45f+sin(glfwGetTime())*0.02, -0.35f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        objShader.setMat4("model", model);
-        lightCrystal.Draw(objShader);
-
-        //plants
-        discardShader.use();
-        discardShader.setMat4("projection", projection);
-        discardShader.setMat4("view", view);
-        glBindVertexArray(transparentVAO2);
-        glBindTexture(GL_TEXTURE_2D, grassTexture);
-        for (unsigned int i = 0; i < plants.size(); i++)
+        objShader.setFloat(objBloomThreshold, bloomThreshold);
+        waterShader.use();
+        waterShader.setFloat(waterCurrentFrame, currentFrame);
+        skyboxShader.use();
+        skyboxShader.setInt(skyboxSampler, 0);
+
+        //models, one instanced draw per mesh, merged into multi-draws by the queue where meshes share a material
+        for (Model *drawnModel : drawnModels)
+            scene.Queue(*drawnModel, renderQueue, deferredShading ? gbufferShader : objShader, frustum, lodSelector, cullStats);
+
+        //plants and the portal, alpha tested quads. The portal is one sided.
+        DrawPacket quad;
+        quad.shader = &discardShader;
+        quad.vertexArray = transparentVAO2;
+        quad.modelUniform = discardModel;
+        quad.count = 6;
+        quad.indexed = true;
+        for (const vector<Scene::Entity> *quads : {&entities.plants, &entities.portals})
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, plants[i]);
-            model = glm::rotate(model, (float)i*60.0f, glm::vec3(0.0, 0.1, 0.0));
-            model = glm::scale(model, glm::vec3(0.4f));
-            discardShader.setMat4("model", model);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-
+            bool portal = quads == &entities.portals;
+            quad.texture = portal ? portalTexture : grassTexture;
+            quad.cullFace = portal ? GL_BACK : GL_NONE;
+            for (Scene::Entity entity : *quads)
+            {
+                quad.model = scene.WorldMatrix(entity);
+                bool visible = frustum.Intersects(quadBounds, quadSphere, quad.model);
+                cullStats.Count(visible);
+                if (!visible)
+                    continue;
+                quad.key = RenderQueue::MakeKey(PASS_ALPHA_TESTED, discardShader.ID, quad.texture, renderQueue.Depth(glm::vec3(quad.model[3])));
+                renderQueue.Push(quad);
+            }
         }
 
-        //portal
-        discardShader.use();
-        discardShader.setMat4("projection", projection);
-        discardShader.setMat4("view", view);
-        glBindVertexArray(transparentVAO2);
-        glBindTexture(GL_TEXTURE_2D, portalTexture);
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.6f, 3.465f, -0.02f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0, 0.1, 0.0));
-        model = glm::rotate(model, (float)(glfwGetTime()*0.05), glm::vec3(0.0, 0.0, 1.0));
-        model = glm::scale(model, glm::vec3(0.745f));
-        discardShader.setMat4("model", model);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-
-        glDisable(GL_CULL_FACE);
-
-        //water rendering
-        waterShader.use();
-        waterShader.setVec3("viewPos", programState->camera.Position);
-        waterShader.setMat4("projection", projection);
-        waterShader.setMat4("view", view);
-        waterShader.setFloat("currentFrame", currentFrame);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-        glBindVertexArray(transparentVAO);
-
-
-        for (auto & waterSquare : waterSquares)
+        //water, blended and seen from below
+        DrawPacket water;
+        water.shader = &waterShader;
+        water.vertexArray = transparentVAO;
+        water.texture = diffuseMap;
+        water.modelUniform = waterModel;
+        water.count = 6;
+        water.cullFace = GL_FRONT;
+        for (Scene::Entity waterSquare : entities.water)
         {
-            glEnable(GL_CULL_FACE);
-            glCullFace(GL_FRONT);
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, waterSquare);
-            waterShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glDisable(GL_CULL_FACE);
-
+            water.model = scene.WorldMatrix(waterSquare);
+            bool visible = frustum.Intersects(waterBounds, waterSphere, water.model);
+            cullStats.Count(visible);
+            if (!visible)
+                continue;
+            water.key = RenderQueue::MakeKey(PASS_TRANSPARENT, waterShader.ID, diffuseMap, renderQueue.Depth(glm::vec3(water.model[3])));
+            renderQueue.Push(water);
         }
 
         //Skybox
-        skyboxShader.use();
-        skyboxShader.setInt("skybox", 0);
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS); // set depth function back to default
+        DrawPacket skybox;
+        skybox.key = RenderQueue::MakeKey(PASS_SKY, skyboxShader.ID, cubeMapTexture, 0.0f);
+        skybox.shader = &skyboxShader;
+        skybox.vertexArray = skyboxVAO;
+        skybox.textureTarget = GL_TEXTURE_CUBE_MAP;
+        skybox.texture = cubeMapTexture;
+        skybox.count = 36;
+        renderQueue.Push(skybox);
+        profiler.End();
+
+        lightClusters.Bind();
+        if (depthPrepass) {
+            // into hdrFBO's depth buffer, which the G-buffer shares
+            profiler.Begin("depth");
+            renderQueue.SubmitDepth(depthShader);
+            profiler.End();
+        }
+        if (deferredShading) {
+            // the opaque models into the G-buffer, which shares the depth buffer cleared with hdrFBO. Only the
+            // view depth needs clearing, 0 marks the pixels the lighting skips.
+            profiler.Begin("gbuffer");
+            glBindFramebuffer(GL_FRAMEBUFFER, renderTargets.GBufferFramebuffer);
+            const float emptyTexel[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            glClearBufferfv(GL_COLOR, 2, emptyTexel);
+            renderQueue.Submit(PASS_OPAQUE, PASS_OPAQUE);
+            profiler.End();
+            profiler.Begin("lighting");
+            deferredLighting.Render(renderTargets, lightStats.lights, bloomThreshold, renderQuad);
+            profiler.End();
+        }
+        // forward: everything, or what the G-buffer can't hold (the alpha tested plants, the water and the sky)
+        profiler.Begin("scene");
+        renderQueue.Submit(deferredShading ? PASS_ALPHA_TESTED : PASS_OPAQUE);
+        sceneDrawCalls = renderQueue.DrawCalls();
+        depthDrawCalls = renderQueue.DepthDrawCalls();
+        scenePackets = (unsigned int)renderQueue.Size();
+        profiler.End();
 
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
 
   //BLOOM
-        // blur bright fragments with two-pass Gaussian Blur
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        unsigned int bloomTexture;
+        float bloomScale = 1.0f;
+        profiler.Begin("blur");
+        if (blurKernelChanged) {
+            GaussianKernel kernel = GaussianKernel::Build(blurSigma, (unsigned int)blurRadius);
+            blurShader.use();
+            blurShader.setInt(blurTaps, (int)kernel.taps);
+            blurShader.setFloatArray(blurWeights, kernel.weights, (int)kernel.taps);
+            blurShader.setFloatArray(blurOffsets, kernel.offsets, (int)kernel.taps);
+            // the compute blur does in one pass what the ping-pong does in five, five blurs of sigma add up to sigma * sqrt(5)
+            if (computeBloom) {
+                float sigma = blurSigma * std::sqrt(5.0f);
+                computeBloom->SetKernel(sigma, (unsigned int)std::ceil(3.0f * sigma));
+            }
+            blurKernelChanged = false;
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (bloomMode == BLOOM_MIP_CHAIN) {
+            // every level of the chain ends up added into the result, average them
+            bloomMipChain.Mips = (unsigned int)bloomMips;
+            bloomTexture = bloomMipChain.Render(colorBuffers[1], renderQuad);
+            bloomScale = 1.0f / bloomMipChain.Mips;
+        } else if (bloomMode == BLOOM_COMPUTE && computeBloom) {
+            // extracts the bright parts of the scene itself, the bright attachment isn't used
+            bloomTexture = computeBloom->Render(colorBuffers[0], bloomThreshold, pingpongColorbuffers,
+                                               renderTargets.BloomWidth(), renderTargets.BloomHeight(), renderTargets.Format());
+        } else {
+            // blur bright fragments with two-pass Gaussian Blur
+            bool horizontal = true, first_iteration = true;
+            unsigned int amount = 10;
+            // the first pass also filters the bright buffer down to the blur targets
+            glViewport(0, 0, renderTargets.BloomWidth(), renderTargets.BloomHeight());
+            blurShader.use();
+            for (unsigned int i = 0; i < amount; i++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+                blurShader.setInt(blurHorizontal, horizontal);
+                GLState::Instance().BindTexture(0, GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
+                renderQuad();
+                horizontal = !horizontal;
+                if (first_iteration)
+                    first_iteration = false;
+            }
+            bloomTexture = pingpongColorbuffers[!horizontal];
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+        profiler.End();
 
         // render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
+        profiler.Begin("composite");
+        glViewport(0, 0, windowWidth, windowHeight);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         bloomShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        bloomShader.setInt("hdr", hdr);
-        bloomShader.setInt("bloom", bloom);
-        bloomShader.setFloat("exposure", exposure);
+        GLState::Instance().BindTexture(0, GL_TEXTURE_2D, colorBuffers[0]);
+        GLState::Instance().BindTexture(1, GL_TEXTURE_2D, bloomTexture);
+        bloomShader.setInt(bloomHdr, hdr);
+        bloomShader.setInt(bloomEnabled, bloom);
+        bloomShader.setFloat(bloomStrength, bloomScale);
+        bloomShader.setFloat(bloomExposure, exposure);
+        bloomShader.setFloat(bloomSharpness, dynamicResolution.Scale < 1.0f ? upscaleSharpness : 0.0f);
         renderQuad();
+        profiler.End();
+
+        // the UI goes on top of the tonemapped image at window resolution
+        if (programState->ImGuiEnabled) {
+            profiler.Begin("imgui");
+            DrawImGui(programState, profiler);
+            profiler.End();
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (!headless) {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        profiler.EndFrame();
     }
 
-    programState->SaveToFile("resources/program_state.txt");
+    profiler.Flush();
+    if (headless) {
+        if (!screenshotPath.empty())
+            headlessContext.SaveScreenshot(screenshotPath);
+        profiler.Report(std::cout);
+        const GLState::Counters &stateCalls = GLState::Instance().Total();
+        std::cout << "GL state calls: " << stateCalls.issued << " issued, " << stateCalls.elided << " elided" << std::endl;
+        std::cout << "scene loaded in " << sceneLoadMilliseconds << " ms (" << (sceneLoadedCooked ? "cooked" : "text") << ")" << std::endl;
+    }
+    if (!tracePath.empty())
+        profiler.WriteChromeTrace(tracePath);
+
+    TextureLoader::Instance().Shutdown();
+    TextureRegistry::Instance().Clear();
+    if (!headless) {
+        programState->SaveToFile("resources/program_state.txt");
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
     delete programState;
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glDeleteVertexArrays(1, &skyboxVAO);
@@ -789,10 +960,20 @@ int main() {
     glDeleteBuffers(1, &transparentVBO);
     glDeleteBuffers(1, &transparentVBO2);
 
-    glfwTerminate();
+    // the headless context goes away with headlessContext, after everything still holding GL objects
+    if (!headless)
+        glfwTerminate();
     return 0;
 }
 
+// headless runs fly a fixed orbit around the island, one revolution every 20 seconds of scene time
+void scriptedCamera(Camera &camera, double time) {
+    const glm::vec3 center(0.0f, 3.2f, 0.0f);
+    float angle = glm::radians(18.0f * (float)time);
+    camera.Position = center + glm::vec3(5.0f * cos(angle), 1.5f, 5.0f * sin(angle));
+    camera.LookAt(center);
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
@@ -860,6 +1041,9 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    // the render targets follow at the start of the next frame
+    windowWidth = (unsigned int)width;
+    windowHeight = (unsigned int)height;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -887,7 +1071,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-void DrawImGui(ProgramState *programState) {
+void DrawImGui(ProgramState *programState, const Profiler &profiler) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -911,6 +1095,113 @@ void DrawImGui(ProgramState *programState) {
         ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
         ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
         ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
+        ImGui::Checkbox("Frustum culling", &frustumCulling);
+        ImGui::Text("Objects visible: %u, culled: %u", cullStats.visible, cullStats.culled);
+        ImGui::Text("Transforms updated: %u / %u", transformsUpdated, sceneEntities);
+        ImGui::Checkbox("Levels of detail", &lodSelector.Enabled);
+        ImGui::SliderFloat("LOD error (pixels)", &lodSelector.Tolerance, 0.25f, 8.0f);
+        const LodSelector::Stats &lods = lodSelector.FrameStats();
+        ImGui::Text("Placements per level: %u / %u / %u / %u", lods.placements[0], lods.placements[1], lods.placements[2],
+                    lods.placements[3]);
+        ImGui::Text("Model triangles: %lu", lods.triangles);
+        if (GLExt::Instance().MultiDrawIndirectSupported())
+            ImGui::Checkbox("Multi-draw indirect", &GeometryArena::Instance().MultiDraw);
+        ImGui::Text("Draw calls: %u for %u packets", sceneDrawCalls, scenePackets);
+        ImGui::Checkbox("Depth pre-pass", &depthPrepass);
+        if (depthPrepass)
+            ImGui::Text("Pre-pass draw calls: %u", depthDrawCalls);
+        ImGui::Text("Geometry: %.2f / %.2f MB", GeometryArena::Instance().UsedBytes() / (1024.0 * 1024.0),
+                    GeometryArena::Instance().CapacityBytes() / (1024.0 * 1024.0));
+        ImGui::Text("Scene loaded in %.2f ms (%s)", sceneLoadMilliseconds, sceneLoadedCooked ? "cooked" : "text");
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Lights");
+        ImGui::Checkbox("Deferred shading", &deferredShading);
+        ImGui::SliderInt("Test lights", &testLights, 0, 1024);
+        ImGui::Text("Point lights: %u", lightStats.lights);
+        ImGui::Text("Light indices: %u, most in one cluster: %u", lightStats.indices, lightStats.maxPerCluster);
+        if (lightStats.dropped)
+            ImGui::Text("Dropped: %u", lightStats.dropped);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Resolution");
+        ImGui::Checkbox("Dynamic resolution", &dynamicResolution.Enabled);
+        if (dynamicResolution.Enabled) {
+            ImGui::DragFloat("GPU budget [ms]", &dynamicResolution.BudgetMilliseconds, 0.1f, 1.0f, 100.0f);
+            ImGui::Text("Render scale: %.2f", dynamicResolution.Scale);
+        } else
+            ImGui::SliderFloat("Render scale", &dynamicResolution.Scale, dynamicResolution.MinScale, dynamicResolution.MaxScale);
+        ImGui::SliderFloat("Upscale sharpness", &upscaleSharpness, 0.0f, 1.0f);
+        ImGui::Text("Internal resolution: %u x %u", (unsigned int)(windowWidth * dynamicResolution.Scale + 0.5f),
+                    (unsigned int)(windowHeight * dynamicResolution.Scale + 0.5f));
+        ImGui::Separator();
+        ImGui::Text("HDR format");
+        ImGui::RadioButton("RGBA16F", &hdrFormat, 0);
+        ImGui::SameLine();
+        ImGui::RadioButton("R11F_G11F_B10F", &hdrFormat, 1);
+        ImGui::Text("Bloom resolution");
+        ImGui::RadioButton("Full", &bloomDivisor, 1);
+        ImGui::SameLine();
+        ImGui::RadioButton("Half", &bloomDivisor, 2);
+        ImGui::SameLine();
+        ImGui::RadioButton("Quarter", &bloomDivisor, 4);
+        ImGui::Text("Render targets: %.2f MB", renderTargetMemory / (1024.0 * 1024.0));
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Bloom");
+        ImGui::Checkbox("Enabled", &bloom);
+        ImGui::RadioButton("Gaussian", &bloomMode, BLOOM_GAUSSIAN);
+        ImGui::SameLine();
+        ImGui::RadioButton("Mip chain", &bloomMode, BLOOM_MIP_CHAIN);
+        if (GLExt::Instance().ComputeSupported()) {
+            ImGui::SameLine();
+            ImGui::RadioButton("Compute", &bloomMode, BLOOM_COMPUTE);
+        }
+        ImGui::DragFloat("Threshold", &bloomThreshold, 0.01f, 0.0f, 10.0f);
+        if (bloomMode == BLOOM_MIP_CHAIN)
+            ImGui::SliderInt("Mip levels", &bloomMips, 1, (int)BloomMipChain::MAX_MIPS);
+        else {
+            blurKernelChanged |= ImGui::DragFloat("Sigma", &blurSigma, 0.05f, 0.5f, 8.0f);
+            blurKernelChanged |= ImGui::SliderInt("Radius", &blurRadius, 1, (int)GaussianKernel::MAX_RADIUS);
+        }
+        ImGui::End();
+    }
+
+    {
+        // rolling averages over the profiler history; the GPU results lag a frame or more behind
+        ImGui::Begin("Profiler");
+        const Profiler::PassStats &frame = profiler.Frame();
+        ImGui::PlotLines("frame cpu", frame.cpuHistory, frame.historyCount, frame.historyOffset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+        ImGui::PlotLines("frame gpu", frame.gpuHistory, frame.historyCount, frame.historyOffset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+        ImGui::Columns(3);
+        ImGui::Text("pass"); ImGui::NextColumn();
+        ImGui::Text("cpu [ms]"); ImGui::NextColumn();
+        ImGui::Text("gpu [ms]"); ImGui::NextColumn();
+        for (const Profiler::PassStats &pass : profiler.Passes()) {
+            float cpu = 0.0f, gpu = 0.0f;
+            for (unsigned int i = 0; i < pass.historyCount; i++) {
+                cpu += pass.cpuHistory[i];
+                gpu += pass.gpuHistory[i];
+            }
+            unsigned int count = std::max(pass.historyCount, 1u);
+            ImGui::Text("%s", pass.name); ImGui::NextColumn();
+            ImGui::Text("%.3f", cpu / count); ImGui::NextColumn();
+            ImGui::PushID(pass.name);
+            ImGui::PlotLines("##gpu", pass.gpuHistory, pass.historyCount, pass.historyOffset, nullptr, 0.0f, FLT_MAX, ImVec2(80, 16));
+            ImGui::PopID();
+            ImGui::SameLine();
+            ImGui::Text("%.3f", gpu / count); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        // calls the state cache forwarded to the driver and skipped because nothing would have changed
+        const GLState::Counters &stateCalls = GLState::Instance().LastFrame();
+        ImGui::Text("GL state calls: %lu issued, %lu elided", stateCalls.issued, stateCalls.elided);
         ImGui::End();
     }
 
@@ -932,149 +1223,122 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 
 unsigned int loadTexture(char const * path, bool gammaCorrection)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // shared through the texture registry, decoded on the texture loader's workers and uploaded by TextureLoader::Update()
+    return TextureRegistry::Instance().Acquire2D(path, gammaCorrection, false);
 }
 
 
 unsigned int loadCubeMap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_SRGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return TextureRegistry::Instance().AcquireCubeMap(faces);
 }
 
-void setShader(Shader myShader, DirLight dirLight, PointLight pointLight, SpotLight spotLight, vector<glm::vec3> lightPos,bool hdr){
-    myShader.use();
-
-    myShader.setVec3("viewPosition", programState->camera.Position);
-    myShader.setFloat("material.shininess", 32.0f);
-
-    // view/projection transformations
-    glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                            (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = programState->camera.GetViewMatrix();
-    myShader.setMat4("projection", projection);
-    myShader.setMat4("view", view);
-
+void updateLights(LightsBlock &lights, vector<PointLight> &pointLights, const DirLight &dirLight, const PointLight &pointLight,
+                  const SpotLight &spotLight, const vector<glm::vec3> &lightPositions, const vector<glm::vec3> &candlePositions, bool hdr){
     //directional lights
-    myShader.setVec3("dirLight.direction", dirLight.direction);
-    myShader.setVec3("dirLight.ambient", dirLight.ambient);
-    myShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-    myShader.setVec3("dirLight.specular", dirLight.specular);
+    lights.dirLight = dirLight;
 
+    // every light and candle the scene places, the clusters decide which fragments they reach
+    pointLights.clear();
 
     //point lights
-    for(unsigned int i=2; i<=4; i++){
-        myShader.setVec3("pointLights[" + std::to_string(i-2) + "].position", lightPos[i]);
-        myShader.setVec3("pointLights[" + std::to_string(i - 2) + "].ambient", pointLight.ambient);
-        myShader.setVec3("pointLights[" + std::to_string(i - 2) + "].diffuse", pointLight.diffuse);
-        myShader.setVec3("pointLights[" + std::to_string(i - 2) + "].specular", pointLight.specular);
-        myShader.setFloat("pointLights[" + std::to_string(i - 2) + "].constant", pointLight.constant);
-        myShader.setFloat("pointLights[" + std::to_string(i - 2) + "].linear", pointLight.linear);
-        myShader.setFloat("pointLights[" + std::to_string(i - 2) + "].quadratic", pointLight.quadratic);
-
+    for (const glm::vec3 &position : lightPositions) {
+        pointLights.push_back(pointLight);
+        pointLights.back().position = position;
     }
-    
+
     //candles
-    for(unsigned int i=0; i<=1; i++){
-        myShader.setVec3("candles[" + std::to_string(i) + "].position", lightPos[i]);
+    for (const glm::vec3 &position : candlePositions) {
+        PointLight candle;
         if(hdr){
-            myShader.setVec3("candles[" + std::to_string(i) + "].ambient", glm::vec3(50.0f,50.0f,200.0f));
-            myShader.setVec3("candles[" + std::to_string(i) + "].diffuse", glm::vec3(1.0));
-            myShader.setVec3("candles[" + std::to_string(i) + "].specular", glm::vec3(1.5));
-            myShader.setFloat("candles[" + std::to_string(i) + "].constant", 1.0f);
-            myShader.setFloat("candles[" + std::to_string(i) + "].linear", 100.0f);
-            myShader.setFloat("candles[" + std::to_string(i) + "].quadratic", 100.0f);
+            candle.ambient = glm::vec3(50.0f,50.0f,200.0f);
+            candle.diffuse = glm::vec3(1.0);
+            candle.specular = glm::vec3(1.5);
+            candle.constant = 1.0f;
+            candle.linear = 100.0f;
+            candle.quadratic = 100.0f;
         }else {
-
-            myShader.setVec3("candles[" + std::to_string(i) + "].diffuse", pointLight.diffuse);
-            myShader.setVec3("candles[" + std::to_string(i) + "].specular", pointLight.specular);
-            myShader.setFloat("candles[" + std::to_string(i) + "].constant", pointLight.constant);
-            myShader.setFloat("candles[" + std::to_string(i) + "].linear", pointLight.linear);
-            myShader.setFloat("candles[" + std::to_string(i) + "].quadratic", pointLight.quadratic);
-            myShader.setVec3("candles[" + std::to_string(i) + "].ambient", pointLight.ambient);
+            candle = pointLight;
         }
+        candle.position = position;
+        pointLights.push_back(candle);
     }
-    
-    
 
     //spot light
-    myShader.setInt("lightOn", programState->lightOn);
-    myShader.setVec3("spotLight.position", programState->camera.Position);
-    myShader.setVec3("spotLight.direction", programState->camera.Front);
-    myShader.setVec3("spotLight.ambient", spotLight.ambient);
-    myShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-    myShader.setVec3("spotLight.specular", spotLight.specular);
-    myShader.setFloat("spotLight.constant", spotLight.constant);
-    myShader.setFloat("spotLight.linear", spotLight.linear);
-    myShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-    myShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-    myShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
+    lights.lightOn = programState->lightOn;
+    lights.spotLight = spotLight;
+    lights.spotLight.position = programState->camera.Position;
+    lights.spotLight.direction = programState->camera.Front;
+}
 
+// scatters count small colored lights over the island, always at the same places
+void addTestLights(vector<PointLight> &pointLights, unsigned int count) {
+    unsigned int seed = 12345;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    for (unsigned int i = 0; i < count; i++) {
+        PointLight light;
+        light.position = glm::vec3(random() * 8.0f - 4.0f, 2.5f + random() * 2.5f, random() * 8.0f - 4.0f);
+        glm::vec3 color(random(), random(), random());
+        light.ambient = color * 0.05f;
+        light.diffuse = color;
+        light.specular = color;
+        light.constant = 1.0f;
+        light.linear = 1.4f;
+        light.quadratic = 7.0f;
+        pointLights.push_back(light);
+    }
+}
+
+// loads the scene description and records how long that took, keeps the current one if the file doesn't parse
+bool loadScene(SceneDescription &description, const std::string &path) {
+    auto start = std::chrono::steady_clock::now();
+    if (!description.Load(path))
+        return false;
+    sceneLoadMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    sceneLoadedCooked = description.cooked;
+    return true;
+}
+
+// loads the models of the description that aren't loaded yet and fills the scene with its instances.
+// Entities are added in instance order, so an entity is also the index of its instance in the description.
+void buildScene(const SceneDescription &description, std::map<std::string, std::unique_ptr<Model>> &loadedModels,
+                vector<Model*> &drawnModels, Scene &scene, SceneEntities &entities) {
+    vector<Model*> models(description.models.size(), nullptr);
+    drawnModels.clear();
+    for (unsigned int i = 0; i < description.models.size(); i++) {
+        // the quads have no path, they are drawn in the render loop
+        const std::string &path = description.models[i].path;
+        if (path.empty())
+            continue;
+        std::unique_ptr<Model> &model = loadedModels[path];
+        if (!model) {
+            model.reset(new Model(path, true));
+            model->SetShaderTextureNamePrefix("material.");
+        }
+        models[i] = model.get();
+        if (std::find(drawnModels.begin(), drawnModels.end(), models[i]) == drawnModels.end())
+            drawnModels.push_back(models[i]);
+    }
+
+    scene.Clear();
+    entities = SceneEntities();
+    for (const SceneInstance &instance : description.instances) {
+        Scene::Entity entity = scene.Add(models[instance.model], instance.position,
+                                         glm::angleAxis(glm::radians(instance.yaw), glm::vec3(0.0f, 1.0f, 0.0f)),
+                                         glm::vec3(instance.scale));
+        SceneRole role = description.models[instance.model].role;
+        if (role == ROLE_PLANT)
+            entities.plants.push_back(entity);
+        else if (role == ROLE_PORTAL)
+            entities.portals.push_back(entity);
+        else if (role == ROLE_WATER)
+            entities.water.push_back(entity);
+        else if (role == ROLE_FLOATING)
+            entities.floating.push_back(entity);
+    }
 }
 
 // renderQuad() renders a 1x1 XY quad in NDC
@@ -1095,7 +1359,7 @@ void renderQuad()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        GLState::Instance().BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1103,7 +1367,6 @@ void renderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    GLState::Instance().BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
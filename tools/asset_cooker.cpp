@@ -0,0 +1,163 @@
+// Offline asset cooker. Converts source assets into the binary formats the renderer loads at startup,
+// so the expensive import only happens here (or once on a cache miss) instead of on every launch.
+//
+// usage: asset_cooker [--force] [model.obj | scene.scene | image.png ...]
+// without file arguments every .obj under resources/objects, every .scene under resources and every image under
+// resources/objects and resources/textures is cooked.
+
+#include <learnopengl/bc_encoder.h>
+#include <learnopengl/dds.h>
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <learnopengl/scene_file.h>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <vector>
+
+void collectFiles(const std::string &directory, const std::vector<std::string> &extensions, std::vector<std::string> &files);
+bool hasExtension(const std::string &path, const std::string &extension);
+bool cookTexture(const std::string &path, bool force);
+
+const std::vector<std::string> MODEL_EXTENSIONS = {".obj"};
+const std::vector<std::string> SCENE_EXTENSIONS = {".scene"};
+const std::vector<std::string> IMAGE_EXTENSIONS = {".png", ".jpg", ".jpeg", ".tga"};
+
+int main(int argc, char **argv) {
+    // cooked textures are stored the way the renderer uploads them, bottom row first
+    stbi_set_flip_vertically_on_load(true);
+
+    bool force = false;
+    std::vector<std::string> models;
+    std::vector<std::string> scenes;
+    std::vector<std::string> images;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--force")
+            force = true;
+        else if (hasExtension(arg, ".obj"))
+            models.push_back(arg);
+        else if (hasExtension(arg, ".scene"))
+            scenes.push_back(arg);
+        else
+            images.push_back(arg);
+    }
+    if (models.empty() && scenes.empty() && images.empty()) {
+        collectFiles(FileSystem::getPath("resources/objects"), MODEL_EXTENSIONS, models);
+        collectFiles(FileSystem::getPath("resources"), SCENE_EXTENSIONS, scenes);
+        collectFiles(FileSystem::getPath("resources/objects"), IMAGE_EXTENSIONS, images);
+        collectFiles(FileSystem::getPath("resources/textures"), IMAGE_EXTENSIONS, images);
+    }
+
+    int failed = 0;
+    for (const std::string &model : models) {
+        if (Model::Cook(model, force)) {
+            std::cout << "cooked " << MeshCache::CachePath(model) << std::endl;
+        } else {
+            std::cout << "failed to cook " << model << std::endl;
+            failed++;
+        }
+    }
+    for (const std::string &scene : scenes) {
+        if (SceneDescription::Cook(scene, force)) {
+            std::cout << "cooked " << SceneDescription::CachePath(scene) << std::endl;
+        } else {
+            std::cout << "failed to cook " << scene << std::endl;
+            failed++;
+        }
+    }
+    for (const std::string &image : images) {
+        if (!cookTexture(image, force)) {
+            std::cout << "failed to cook " << image << std::endl;
+            failed++;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+// compresses an image into <image>.dds with a full mip chain. The block format follows the image contents:
+// one channel -> BC4, names containing "normal" -> BC5, any transparent texel -> BC3, everything else BC1.
+bool cookTexture(const std::string &path, bool force) {
+    if (!force && CookedTextureUpToDate(path)) {
+        std::cout << "up to date " << CookedTexturePath(path) << std::endl;
+        return true;
+    }
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrComponents, 4);
+    if (!data)
+        return false;
+
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    bool transparent = false;
+    for (size_t i = 0; i < (size_t)width * height && !transparent; i++)
+        transparent = data[i * 4 + 3] < 255;
+
+    BlockFormat format = BlockFormat::BC1;
+    if (nrComponents == 1)
+        format = BlockFormat::BC4;
+    else if (name.find("normal") != std::string::npos)
+        format = BlockFormat::BC5;
+    else if (transparent)
+        format = BlockFormat::BC3;
+    // color textures are sampled as sRGB, so their mips are filtered in linear space
+    bool srgb = format == BlockFormat::BC1 || format == BlockFormat::BC3;
+
+    std::vector<std::vector<unsigned char>> levels;
+    std::vector<unsigned char> level(data, data + (size_t)width * height * 4);
+    stbi_image_free(data);
+    unsigned int levelWidth = width, levelHeight = height;
+    while (true) {
+        levels.push_back(CompressImage(level.data(), levelWidth, levelHeight, format));
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        level = DownsampleImage(level.data(), levelWidth, levelHeight, srgb, levelWidth, levelHeight);
+    }
+    if (!WriteDds(CookedTexturePath(path), format, width, height, levels))
+        return false;
+
+    size_t compressedSize = 0;
+    for (const std::vector<unsigned char> &compressed : levels)
+        compressedSize += compressed.size();
+    std::cout << "cooked " << CookedTexturePath(path) << " (" << dds::formatFourCC(format) << ", "
+              << levels.size() << " mips, " << compressedSize / 1024 << " KiB)" << std::endl;
+    return true;
+}
+
+bool hasExtension(const std::string &path, const std::string &extension) {
+    if (path.size() <= extension.size())
+        return false;
+    for (size_t i = 0; i < extension.size(); i++) {
+        if (std::tolower((unsigned char)path[path.size() - extension.size() + i]) != extension[i])
+            return false;
+    }
+    return true;
+}
+
+// recursively collects all files with one of the given extensions
+void collectFiles(const std::string &directory, const std::vector<std::string> &extensions, std::vector<std::string> &files) {
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        return;
+    while (dirent *entry = readdir(dir)) {
+        std::string name(entry->d_name);
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + '/' + name;
+        if (entry->d_type == DT_DIR) {
+            collectFiles(path, extensions, files);
+            continue;
+        }
+        for (const std::string &extension : extensions) {
+            if (hasExtension(name, extension)) {
+                files.push_back(path);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+}